@@ -52,9 +52,10 @@ const cli_arguments_t parse_arguments(int argc, char** argv) {
 			break;
 		}
 
-		// Also components and undirected has no data attached to it.
+		// Also components, undirected, h5-shuffle, resume and apparent-pairs have no data attached to them.
 		// TODO: How to make this nicer without a lot of overhead
-		if (arg == "components" || arg == "undirected") {
+		if (arg == "components" || arg == "undirected" || arg == "h5-shuffle" || arg == "resume" ||
+		    arg == "apparent-pairs") {
 			named_arguments.insert(std::make_pair(arg, "true"));
 			continue;
 		}
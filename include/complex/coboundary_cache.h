@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../definitions.h"
+#include "../directed_graph.h"
+#include "../persistence.h"
+
+// The coboundary matrix of every thread is cached in the file "matrix_<dimension>_<thread>": this header,
+// followed by the column bounds and the entries exactly as they are laid out in memory, so that the file
+// can be mapped as the matrix. The entries contain the coefficients if the build uses them, the entry size
+// and the key make sure that a cache is only used by a matching build and run.
+const char COBOUNDARY_CACHE_MAGIC[8] = {'F', 'L', 'A', 'G', 'S', 'E', 'R', 'C'};
+const uint32_t COBOUNDARY_CACHE_VERSION = 3;
+
+struct coboundary_cache_header_t {
+	char magic[8];
+	uint32_t version;
+	uint32_t entry_size;
+	uint32_t dimension;
+	uint32_t thread;
+	uint32_t number_of_threads;
+	coboundary_cache_key_t key;
+	uint64_t next_cell_count;
+	uint64_t offset;
+	uint64_t columns;
+	uint64_t entries;
+	uint64_t checksum;
+};
+
+// FNV-1a on 64 bit words
+uint64_t cache_checksum(const void* data, size_t bytes, uint64_t hash = 14695981039346656037ULL) {
+	const char* p = reinterpret_cast<const char*>(data);
+	for (size_t i = 0; i + 8 <= bytes; i += 8) {
+		uint64_t word;
+		memcpy(&word, p + i, 8);
+		hash = (hash ^ word) * 1099511628211ULL;
+	}
+	for (size_t i = bytes & ~size_t(7); i < bytes; i++) hash = (hash ^ uint8_t(p[i])) * 1099511628211ULL;
+	return hash;
+}
+
+uint64_t mix_bits(uint64_t x) {
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+// Has to be called before the filtration algorithm changes the filtration values of the graph
+coboundary_cache_key_t coboundary_cache_key(std::string filtration, coefficient_t modulus,
+                                            const filtered_directed_graph_t& graph) {
+	coboundary_cache_key_t key;
+	memset(&key, 0, sizeof(key));
+	std::transform(filtration.begin(), filtration.end(), filtration.begin(), ::tolower);
+	strncpy(key.filtration, filtration.c_str(), sizeof(key.filtration) - 1);
+	key.modulus = modulus;
+	key.vertices = graph.vertex_number();
+	key.edges = graph.edge_number();
+	for (size_t e = 0; e < graph.edge_number(); e++) {
+		uint64_t value = 0;
+		if (e < graph.edge_filtration.size()) memcpy(&value, &graph.edge_filtration[e], sizeof(value_t));
+		key.graph_hash += mix_bits((uint64_t(graph.edges[2 * e]) << 32 | graph.edges[2 * e + 1]) ^ mix_bits(value));
+	}
+	key.graph_hash =
+	    cache_checksum(graph.vertex_filtration.data(), graph.vertex_filtration.size() * sizeof(value_t), key.graph_hash);
+	return key;
+}
+
+// Maps the cached coboundary matrices of the given dimension and reads the filtration of the next cells.
+// Returns false (and leaves the matrices empty and the cell count and filtration untouched) if the cache does
+// not contain valid files for this dimension that were written by a run with the same key. The number of
+// cells of this dimension is checked if it is known (non-zero).
+bool load_cached_coboundaries(const std::string& cache, const coboundary_cache_key_t& key, int dimension,
+                              size_t cell_count, bool with_filtration,
+                              compressed_sparse_matrix<entry_t>* coboundary_matrix, size_t* coboundary_matrix_offsets,
+                              size_t& next_cell_count, std::vector<value_t>& next_filtration) {
+	size_t columns = 0;
+	size_t cached_next_cell_count = 0;
+	std::string prefix = cache + "/matrix_" + std::to_string(dimension) + "_";
+	for (int i = 0; i < PARALLEL_THREADS; i++) {
+		std::string fname = prefix + std::to_string(i);
+		int fd = open(fname.c_str(), O_RDONLY);
+		if (fd == -1) {
+			if (i > 0)
+				std::cerr << "The cache file " << fname << " is missing, recomputing dimension " << dimension << "."
+				          << std::endl;
+			for (int j = 0; j < PARALLEL_THREADS; j++) coboundary_matrix[j].clear();
+			return false;
+		}
+
+		struct stat info;
+		size_t file_size = fstat(fd, &info) == 0 ? info.st_size : 0;
+		void* memory = file_size >= sizeof(coboundary_cache_header_t)
+		                   ? mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0)
+		                   : MAP_FAILED;
+		close(fd);
+
+		bool valid = memory != MAP_FAILED;
+		if (valid) {
+			std::shared_ptr<const void> mapping(memory,
+			                                    [file_size](const void* p) { munmap(const_cast<void*>(p), file_size); });
+			const auto& header = *reinterpret_cast<const coboundary_cache_header_t*>(memory);
+			const size_t* bounds = reinterpret_cast<const size_t*>(&header + 1);
+			const entry_t* entries = reinterpret_cast<const entry_t*>(bounds + header.columns);
+
+			valid = memcmp(header.magic, COBOUNDARY_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+			        header.version == COBOUNDARY_CACHE_VERSION && header.entry_size == sizeof(entry_t) &&
+			        header.dimension == dimension && header.thread == i &&
+			        header.number_of_threads == PARALLEL_THREADS && memcmp(&header.key, &key, sizeof(key)) == 0 &&
+			        (i == 0 || header.next_cell_count == cached_next_cell_count) && header.offset == columns &&
+			        file_size == sizeof(header) + header.columns * sizeof(size_t) + header.entries * sizeof(entry_t) &&
+			        (header.columns == 0 ? header.entries == 0 : bounds[header.columns - 1] == header.entries) &&
+			        cache_checksum(bounds, file_size - sizeof(header)) == header.checksum;
+
+			if (valid) {
+				coboundary_matrix[i].map(mapping, bounds, entries, header.columns);
+				coboundary_matrix_offsets[i] = header.offset;
+				cached_next_cell_count = header.next_cell_count;
+				columns += header.columns;
+			}
+		}
+
+		if (!valid) {
+			std::cerr << "The cache file " << fname << " is invalid, recomputing dimension " << dimension << "."
+			          << std::endl;
+			for (int j = 0; j < PARALLEL_THREADS; j++) coboundary_matrix[j].clear();
+			return false;
+		}
+	}
+
+	// Every cell has a column, except in the top dimension of the in-memory complex which is stored without
+	// coboundaries
+	bool valid = cell_count == 0 || columns == cell_count || (columns == 0 && cached_next_cell_count == 0);
+
+	std::vector<value_t> filtration;
+	std::ifstream f(cache + "/filtration_" + std::to_string(dimension), std::ios::binary | std::ios::ate);
+	const size_t filtration_size = with_filtration ? cached_next_cell_count : 0;
+	if (valid) valid = f.good() && size_t(f.tellg()) == filtration_size * sizeof(value_t);
+	if (valid) {
+		filtration.resize(filtration_size);
+		f.seekg(0);
+		valid = bool(f.read((char*)filtration.data(), filtration_size * sizeof(value_t)));
+	}
+
+	if (!valid) {
+		std::cerr << "The cache for dimension " << dimension << " does not match the complex, recomputing it."
+		          << std::endl;
+		for (int j = 0; j < PARALLEL_THREADS; j++) coboundary_matrix[j].clear();
+		return false;
+	}
+
+	next_cell_count = cached_next_cell_count;
+	next_filtration.swap(filtration);
+	return true;
+}
+
+void cache_coboundaries(const std::string& cache, const coboundary_cache_key_t& key, int dimension,
+                        const compressed_sparse_matrix<entry_t>* coboundary_matrix,
+                        const size_t* coboundary_matrix_offsets, size_t next_cell_count,
+                        const std::vector<value_t>& next_filtration) {
+	for (int i = 0; i < PARALLEL_THREADS; i++) {
+		const auto& matrix = coboundary_matrix[i];
+		const size_t columns = matrix.size();
+		const size_t entries = matrix.number_of_entries();
+
+		coboundary_cache_header_t header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, COBOUNDARY_CACHE_MAGIC, sizeof(header.magic));
+		header.version = COBOUNDARY_CACHE_VERSION;
+		header.entry_size = sizeof(entry_t);
+		header.dimension = dimension;
+		header.thread = i;
+		header.number_of_threads = PARALLEL_THREADS;
+		header.key = key;
+		header.next_cell_count = next_cell_count;
+		header.offset = coboundary_matrix_offsets[i];
+		header.columns = columns;
+		header.entries = entries;
+		header.checksum = cache_checksum(matrix.entries_data(), entries * sizeof(entry_t),
+		                                 cache_checksum(matrix.bounds_data(), columns * sizeof(size_t)));
+
+		std::string fname = cache + "/matrix_" + std::to_string(dimension) + "_" + std::to_string(i);
+		std::ofstream o(fname.c_str(), std::ios::binary);
+		o.write((char*)&header, sizeof(header));
+		o.write((char*)matrix.bounds_data(), columns * sizeof(size_t));
+		o.write((char*)matrix.entries_data(), entries * sizeof(entry_t));
+		o.close();
+		if (o.fail()) {
+			std::cerr << "couldn't write the cache file " << fname << std::endl;
+			exit(-1);
+		}
+	}
+
+	std::string fname = cache + "/filtration_" + std::to_string(dimension);
+	std::ofstream o(fname.c_str(), std::ios::binary);
+	o.write((char*)next_filtration.data(), next_filtration.size() * sizeof(value_t));
+	o.close();
+	if (o.fail()) {
+		std::cerr << "couldn't write the cache file " << fname << std::endl;
+		exit(-1);
+	}
+}
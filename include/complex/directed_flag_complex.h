@@ -140,14 +140,16 @@ struct cell_hasher_t {
 	}
 
 #ifdef USE_CELLS_WITHOUT_DIMENSION
+	// The dimension is kept per thread, so that several complexes can be computed at the same time. The worker
+	// threads of for_each_cell start with the dimension of the calling thread.
 	static void set_current_cell_dimension(unsigned int _dimension) { dimension = _dimension; }
-	static unsigned int dimension;
+	static thread_local unsigned int dimension;
 #endif
 private:
 	std::hash<vertex_index_t> hasher;
 };
 #ifdef USE_CELLS_WITHOUT_DIMENSION
-unsigned int cell_hasher_t::dimension = 0;
+thread_local unsigned int cell_hasher_t::dimension = 0;
 #endif
 
 struct cell_comparer_t {
@@ -183,11 +185,26 @@ public:
 	template <typename Func, size_t number_of_threads>
 	void for_each_cell(std::array<Func*, number_of_threads>& fs, int min_dimension, int max_dimension = -1) {
 		if (max_dimension == -1) max_dimension = min_dimension;
+
+		if (compute_serially() || graph.edge_number() < MINIMAL_EDGES_FOR_THREADS) {
+			for (size_t index = 0; index < number_of_threads; ++index)
+				worker_thread(number_of_threads, index, fs[index], min_dimension, max_dimension);
+			return;
+		}
+
 		std::thread t[number_of_threads - 1];
 
-		for (size_t index = 0; index < number_of_threads - 1; ++index)
-			t[index] = std::thread(&directed_flag_complex_t::worker_thread<Func>, this, number_of_threads, index,
-			                       fs[index], min_dimension, max_dimension);
+#ifdef USE_CELLS_WITHOUT_DIMENSION
+		const unsigned int cell_dimension = cell_hasher_t::dimension;
+#endif
+		for (size_t index = 0; index < number_of_threads - 1; ++index) {
+			t[index] = std::thread([&, index]() {
+#ifdef USE_CELLS_WITHOUT_DIMENSION
+				cell_hasher_t::set_current_cell_dimension(cell_dimension);
+#endif
+				worker_thread(number_of_threads, index, fs[index], min_dimension, max_dimension);
+			});
+		}
 
 		// Also do work in this thread, namely the last bit
 		worker_thread(number_of_threads, number_of_threads - 1, fs[number_of_threads - 1], min_dimension,
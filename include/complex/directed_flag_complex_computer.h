@@ -9,6 +9,7 @@
 #include "../directed_graph.h"
 #include "../filtration_algorithms.h"
 #include "../persistence.h"
+#include "coboundary_cache.h"
 #include "directed_flag_complex.h"
 
 typedef hash_map<directed_flag_complex_cell_t, size_t, cell_hasher_t, cell_comparer_t> cell_hash_map_t;
@@ -16,48 +17,29 @@ typedef hash_map<directed_flag_complex_cell_t, size_t, cell_hasher_t, cell_compa
 template <typename Complex> class coboundary_iterator_t {
 	const Complex* complex;
 	short dimension;
-	const compressed_sparse_matrix<entry_t>& matrix;
-	const index_t index;
+	const entry_t* current = nullptr;
+	const entry_t* end = nullptr;
   const coefficient_t coefficient;
   const coefficient_t modulus;
-	size_t current_offset = 0;
 
 public:
-	coboundary_iterator_t(const Complex* _complex, short _dimension, const compressed_sparse_matrix<entry_t>& _matrix,
-	                      index_t _index, coefficient_t _coefficient, coefficient_t _modulus)
-	    : complex(_complex), dimension(_dimension), matrix(_matrix), index(_index), coefficient(_coefficient), modulus(_modulus) {}
+	coboundary_iterator_t(const Complex* _complex, short _dimension, const compressed_sparse_matrix<entry_t>& matrix,
+	                      index_t index, coefficient_t _coefficient, coefficient_t _modulus)
+	    : complex(_complex), dimension(_dimension), coefficient(_coefficient), modulus(_modulus) {
+		if (index == -1) return;
+		current = matrix.cbegin(index);
+		end = matrix.cend(index);
+	}
 
-	bool has_next() { return index != -1 && matrix.cbegin(index) + current_offset != matrix.cend(index); }
+	bool has_next() { return current != end; }
 
 	filtration_entry_t next() {
-		entry_t entry = *(matrix.cbegin(index) + current_offset++);
+		entry_t entry = *current++;
     coefficient_t coface_coefficient = get_coefficient(entry) * coefficient % modulus;
 		return filtration_entry_t(complex->filtration(dimension + 1, get_index(entry)), get_index(entry), coface_coefficient);
 	}
 };
 
-struct reorder_edges_t {
-	reorder_edges_t(std::vector<vertex_index_t>& _new_edges, bool _reorder_filtration,
-	                hash_map<directed_flag_complex_cell_t, size_t, cell_hasher_t, cell_comparer_t>& _cell_hash,
-	                std::vector<value_t>& _old_filtration, std::vector<value_t>& _new_filtration)
-	    : cell_hash(_cell_hash), old_filtration(_old_filtration), new_filtration(_new_filtration),
-	      new_edges(_new_edges), reorder_filtration(_reorder_filtration) {}
-	void done() {}
-	void operator()(vertex_index_t* first_vertex, int size) {
-		directed_flag_complex_cell_t cell(first_vertex);
-		if (reorder_filtration) new_filtration.push_back(old_filtration[cell_hash.find(cell)->second]);
-		new_edges.push_back(cell.vertex(0));
-		new_edges.push_back(cell.vertex(1));
-	}
-
-private:
-	hash_map<directed_flag_complex_cell_t, size_t, cell_hasher_t, cell_comparer_t>& cell_hash;
-	std::vector<value_t>& old_filtration;
-	std::vector<value_t>& new_filtration;
-	std::vector<vertex_index_t>& new_edges;
-	bool reorder_filtration;
-};
-
 struct compute_filtration_t {
 	compute_filtration_t(filtration_algorithm_t* _filtration_algorithm, const filtered_directed_graph_t& _graph,
 	                     const std::vector<value_t>& _current_filtration, vertex_index_t _vertices_per_thread = -1,
@@ -165,41 +147,7 @@ void prepare_graph_filtration(Complex& complex, filtered_directed_graph_t& graph
 
 	// Now, we reorder the edges and their filtration value such that it matches
 	// the iteration order of "for_each_cell"
-	std::vector<vertex_index_t> new_edges[PARALLEL_THREADS];
-	std::vector<value_t> new_filtrations[PARALLEL_THREADS];
-
-	hash_map<directed_flag_complex_cell_t, size_t, cell_hasher_t, cell_comparer_t> hash;
-	if (filtration_algorithm != nullptr) {
-		cell_hasher_t::set_current_cell_dimension(1);
-		vertex_index_t* e = &(graph.edges[0]);
-		directed_flag_complex_cell_t c;
-		for (size_t i = 0; i < graph.edges.size() / 2; ++i, e += 2) {
-			c.set_vertices(e);
-			hash.insert(std::make_pair(c, i));
-		}
-	}
-
-	std::array<reorder_edges_t*, PARALLEL_THREADS> reorder_filtration;
-	for (int i = 0; i < PARALLEL_THREADS; i++) {
-		reorder_filtration[i] =
-		    new reorder_edges_t(new_edges[i], !computed_edge_filtration && filtration_algorithm != nullptr, hash,
-		                        graph.edge_filtration, new_filtrations[i]);
-	}
-	complex.for_each_cell(reorder_filtration, 1);
-
-	hash.clear();
-	hash_map<directed_flag_complex_cell_t, size_t, cell_hasher_t, cell_comparer_t> empty;
-	std::swap(hash, empty);
-
-	size_t current_filtration_index = 0;
-	size_t current_edge_index = 0;
-	for (int i = 0; i < PARALLEL_THREADS; i++) {
-		if (!computed_edge_filtration)
-			for (auto f : new_filtrations[i]) graph.edge_filtration[current_filtration_index++] = f;
-		for (auto e : new_edges[i]) graph.edges[current_edge_index++] = e;
-	}
-
-	for (int i = 0; i < PARALLEL_THREADS; i++) delete reorder_filtration[i];
+	graph.sort_edges_in_enumeration_order(PARALLEL_THREADS, !computed_edge_filtration && filtration_algorithm != nullptr);
 }
 
 class directed_flag_complex_computer_t {
@@ -211,7 +159,11 @@ class directed_flag_complex_computer_t {
 	int current_dimension = 0;
 	bool _is_top_dimension = false;
 	std::vector<size_t> cell_count;
+	// The number of cells of the dimension cells_per_thread_dimension that every thread enumerates
+	std::array<size_t, PARALLEL_THREADS> cells_per_thread;
+	int cells_per_thread_dimension = -1;
 	std::string cache;
+	coboundary_cache_key_t cache_key;
 
 	directed_flag_complex_t flag_complex;
 
@@ -234,6 +186,10 @@ public:
 		cell_count.push_back(_graph.vertex_number());
 		cell_count.push_back(_graph.edge_number());
 
+		if (cache != "")
+			cache_key = coboundary_cache_key(get_argument_or_default(named_arguments, "filtration", "zero"), modulus,
+			                                 graph);
+
 		// Order the edges and compute the correct filtration
 		if (min_dimension <= 1 || (filtration_algorithm != nullptr && filtration_algorithm->needs_face_filtration()))
 			prepare_graph_filtration(flag_complex, graph, filtration_algorithm);
@@ -303,13 +259,20 @@ struct add_cell_index_to_cache_t {
 		cell_hasher_t::set_current_cell_dimension(size - 1);
 
 		cache->insert(std::make_pair(cell, current_index));
+
+		// The cell is a coface of its faces, those without the first vertex belong to the thread of the second
+		// vertex, the others to the thread of the first one
+		faces_per_thread[first_vertex[0] % PARALLEL_THREADS] += size - 1;
+		faces_per_thread[first_vertex[1] % PARALLEL_THREADS]++;
 	}
 
 	index_t number_of_cells() const { return current_index + 1; }
+	size_t number_of_faces(int thread) const { return faces_per_thread[thread]; }
 
 private:
 	cell_hash_map_t* cache;
 	index_t current_index = -1;
+	size_t faces_per_thread[PARALLEL_THREADS] = {};
 };
 
 struct store_coboundaries_in_cache_t {
@@ -414,62 +377,38 @@ void directed_flag_complex_computer_t::prepare_next_dimension(int dimension) {
 	cell_count.resize(dimension + 2);
 
 	// Clean up
-	for (auto p : coboundary_matrix) { p.clear(); }
+	for (auto& p : coboundary_matrix) { p.clear(); }
 
 	if (dimension > max_dimension || _is_top_dimension) return;
 
 	vertex_index_t vertices_per_thread = graph.number_of_vertices / PARALLEL_THREADS;
 
-	if (cache != "") {
-#ifdef USE_COEFFICIENTS
-		// TODO: Make this work
-		std::cerr << "Sorry, caching does not work with coefficients yet." << std::endl;
-		exit(1);
-#endif
-		bool loaded_from_file = false;
-		for (int i = 0; i < PARALLEL_THREADS; i++) {
-			coboundary_matrix[i].clear();
-			std::string fname = cache;
-			fname += "/matrix_";
-			fname += std::to_string(current_dimension);
-			fname += "_";
-			fname += std::to_string(i);
-			std::ifstream f(fname.c_str(), std::ios::binary);
-			if (i == 0 && !f.good()) break;
-			loaded_from_file = true;
-
-			f.read((char*)&(cell_count[current_dimension + 1]), sizeof(size_t));
-			f.read((char*)&(coboundary_matrix_offsets[i]), sizeof(size_t));
-
-			size_t this_size;
-			f.read((char*)&(this_size), sizeof(size_t));
-
-			index_t next_value;
-			while (this_size > 0 && f.read((char*)&next_value, sizeof(index_t))) {
-				if (next_value == -1)
-					coboundary_matrix[i].append_column();
-				else
-					coboundary_matrix[i].push_back(next_value);
-			}
-			f.close();
-		}
-
-		std::string fname = cache;
-		fname += "/filtration_";
-		fname += std::to_string(current_dimension);
-		std::ifstream f(fname.c_str(), std::ios::binary);
-		next_filtration.clear();
-		value_t next_value;
-		while (f.read((char*)&next_value, sizeof(value_t))) next_filtration.push_back(next_value);
-		f.close();
-
-		if (loaded_from_file) {
-			_is_top_dimension = cell_count[current_dimension + 1] == 0;
-			return;
-		}
+	if (cache != "" && load_cached_coboundaries(cache, cache_key, current_dimension, cell_count[current_dimension],
+	                                            filtration_algorithm != nullptr, coboundary_matrix,
+	                                            coboundary_matrix_offsets, cell_count[current_dimension + 1],
+	                                            next_filtration)) {
+		// The in-memory complex stores the top dimension without coboundaries
+		size_t columns = 0;
+		for (auto& matrix : coboundary_matrix) columns += matrix.size();
+		if (columns > 0) cell_count[current_dimension] = columns;
+		_is_top_dimension = cell_count[current_dimension + 1] == 0;
+		return;
 	}
 
 	{
+		// The sizes of the coboundary matrices, to allocate them up front
+		std::array<size_t, PARALLEL_THREADS> columns, entries;
+		if (dimension == 1) {
+			cells_per_thread.fill(0);
+			for (size_t e = 0; e < graph.edge_number(); e++) cells_per_thread[graph.edges[2 * e] % PARALLEL_THREADS]++;
+			cells_per_thread_dimension = 1;
+		}
+		if (cells_per_thread_dimension == dimension)
+			columns = cells_per_thread;
+		else
+			columns.fill(0);
+		entries.fill(0);
+
 		if (filtration_algorithm != nullptr) {
 			// Add the current and next cells into the hash and compute the new
 			// filtration
@@ -508,7 +447,11 @@ void directed_flag_complex_computer_t::prepare_next_dimension(int dimension) {
 				flag_complex.for_each_cell(compute_filtration, dimension + 1);
 
 				size_t _cell_count = 0;
-				for (int i = 0; i < PARALLEL_THREADS; i++) _cell_count += compute_filtration[i]->number_of_cells();
+				for (int i = 0; i < PARALLEL_THREADS; i++) {
+					cells_per_thread[i] = compute_filtration[i]->number_of_cells();
+					_cell_count += cells_per_thread[i];
+				}
+				cells_per_thread_dimension = dimension + 1;
 				cell_count[dimension + 1] = _cell_count;
 				if (_cell_count == 0) _is_top_dimension = true;
 
@@ -558,14 +501,20 @@ void directed_flag_complex_computer_t::prepare_next_dimension(int dimension) {
 			for (int i = 0; i < PARALLEL_THREADS; i++) {
 				_cache_next_cells_offsets[i] = _cell_count;
 				_cell_count += init_next_cell_cache[i]->number_of_cells();
+				cells_per_thread[i] = init_next_cell_cache[i]->number_of_cells();
+				for (int j = 0; j < PARALLEL_THREADS; j++) entries[j] += init_next_cell_cache[i]->number_of_faces(j);
 			}
+			cells_per_thread_dimension = dimension + 1;
 			cell_count[dimension + 1] = _cell_count;
 			if (_cell_count == 0) _is_top_dimension = true;
 		}
 
 		// Now compute the coboundaries
 		std::array<store_coboundaries_in_cache_t*, PARALLEL_THREADS> store_coboundaries;
-		for (int i = 0; i < PARALLEL_THREADS; i++) coboundary_matrix[i] = compressed_sparse_matrix<entry_t>();
+		for (int i = 0; i < PARALLEL_THREADS; i++) {
+			coboundary_matrix[i] = compressed_sparse_matrix<entry_t>();
+			coboundary_matrix[i].reserve(columns[i], entries[i]);
+		}
 		for (int i = 0; i < PARALLEL_THREADS; i++) {
 			store_coboundaries[i] = new store_coboundaries_in_cache_t(
 			    coboundary_matrix[i], dimension, graph, _cache_next_cells, _cache_next_cells_offsets,
@@ -595,33 +544,7 @@ void directed_flag_complex_computer_t::prepare_next_dimension(int dimension) {
 		}
 	}
 
-	if (cache != "") {
-		for (int i = 0; i < PARALLEL_THREADS; i++) {
-			std::string fname = cache;
-			fname += "/matrix_";
-			fname += std::to_string(current_dimension);
-			fname += "_";
-			fname += std::to_string(i);
-			std::ofstream o(fname.c_str(), std::ios::binary);
-			index_t separator = -1;
-			o.write((char*)&(cell_count[current_dimension + 1]), sizeof(size_t));
-			o.write((char*)&(coboundary_matrix_offsets[i]), sizeof(size_t));
-			size_t this_size = coboundary_matrix[i].size();
-			o.write((char*)&this_size, sizeof(size_t));
-			for (int j = 0; j < this_size; j++) {
-				o.write((char*)&(separator), sizeof(index_t));
-				for (auto it = coboundary_matrix[i].cbegin(j); it != coboundary_matrix[i].cend(j); ++it) {
-					o.write((char*)&(*it), sizeof(index_t));
-				}
-			}
-			o.close();
-		}
-
-		std::string fname = cache;
-		fname += "/filtration_";
-		fname += std::to_string(current_dimension);
-		std::ofstream o(fname.c_str(), std::ios::binary);
-		for (auto f : next_filtration) o.write((char*)&f, sizeof(value_t));
-		o.close();
-	}
+	if (cache != "")
+		cache_coboundaries(cache, cache_key, current_dimension, coboundary_matrix, coboundary_matrix_offsets,
+		                   cell_count[current_dimension + 1], next_filtration);
 }
@@ -1,10 +1,12 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
-#include <map>
+#include <functional>
+#include <iostream>
 #include <thread>
-#include <unordered_set>
 #include <vector>
 
 #include "../definitions.h"
@@ -13,113 +15,70 @@
 //
 // Loading the whole complex into memory, trading memory for computation speed
 //
-template <typename ExtraData> class directed_flag_complex_cell_in_memory_t {
-public:
-	vertex_index_t vertex;
-	ExtraData data;
-	std::map<vertex_index_t, directed_flag_complex_cell_in_memory_t<ExtraData>>* children = nullptr;
-
-	directed_flag_complex_cell_in_memory_t(vertex_index_t _vertex) : vertex(_vertex) {}
-
-	// TODO: Figure out how to do this in the destructor.
-	//       The problem was that the classes are copied around, so the destructor was called before
-	//       the actual destruction of the complex took place.
-	void free_memory() {
-		if (children != nullptr) {
-			for (auto c : *children) c.second.free_memory();
-			delete children;
-		}
-	}
-
-	directed_flag_complex_cell_in_memory_t& add_child(vertex_index_t vertex) {
-		if (children == nullptr)
-			children = new std::map<vertex_index_t, directed_flag_complex_cell_in_memory_t<ExtraData>>();
-		directed_flag_complex_cell_in_memory_t<ExtraData> new_cell(vertex);
-
-		// Insert and return the cell
-		return children->insert(std::make_pair(new_cell.vertex, new_cell)).first->second;
-	}
+// The complex is stored as a trie, level by level: the cells of dimension d are the nodes of level d, each given
+// by its last vertex. The cofaces of a cell that append a vertex to it are its children, they are stored
+// consecutively (sorted by their last vertex) in the next level. The cells of every level are in the order of
+// the depth-first enumeration of the complex, so the vertex of level 0 at position v is v.
+template <typename ExtraData> struct directed_flag_complex_level_in_memory_t {
+	std::vector<vertex_index_t> vertices;
+	// The children of the cell at position i are at the positions [children[i], children[i + 1]) of the next level
+	std::vector<size_t> children;
+	// The data of the levels above the edges is only allocated when the cells are first visited
+	std::vector<ExtraData> data;
+};
 
-	template <typename Cell> void set_data(int dimension, const Cell vertices, ExtraData _data, int offset = 0) {
-		if (dimension == 0) {
-			data = _data;
-			return;
-		}
+template <typename ExtraData> class directed_flag_complex_in_memory_t {
+	bool use_threads;
 
-		if (children == nullptr) {
-			std::cerr << "A cell could not be found in the directed flag complex." << std::endl;
-			exit(-1);
-		}
+public:
+	std::vector<directed_flag_complex_level_in_memory_t<ExtraData>> levels;
 
-		offset++;
-		auto pair = children->find(vertices[offset]);
-		if (pair == children->end()) {
-			std::cerr << "A cell could not be found in the directed flag complex." << std::endl;
-			exit(-1);
-		}
+	// Only the cells up to the given dimension are constructed, all of them if it is -1
+	directed_flag_complex_in_memory_t(const directed_graph_t& graph, int max_dimension = -1);
 
-		pair->second.set_data(dimension - 1, vertices, _data, offset);
+	size_t number_of_cells(int dimension) const {
+		return dimension < levels.size() ? levels[dimension].vertices.size() : 0;
 	}
 
-	template <typename Cell> const ExtraData& get_data(int dimension, const Cell vertices, int offset = 0) const {
-		if (dimension == 0) return data;
-
-		if (children == nullptr) {
-			std::cerr << "A cell could not be found in the directed flag complex." << std::endl;
-			exit(-1);
+	// The number of cells of the given dimension that start with the cell at the given position of the given level,
+	// they are stored consecutively
+	size_t number_of_cells_below(int dimension, int level, size_t position) const {
+		if (dimension >= levels.size()) return 0;
+		size_t begin = position, end = position + 1;
+		for (int d = level; d < dimension; d++) {
+			begin = levels[d].children[begin];
+			end = levels[d].children[end];
 		}
-
-		offset++;
-		auto pair = children->find(vertices[offset]);
-		if (pair == children->end()) {
-			std::cerr << "A cell could not be found in the directed flag complex." << std::endl;
-			exit(-1);
-		}
-
-		return pair->second.get_data(dimension - 1, vertices, offset);
+		return end - begin;
 	}
 
-	template <typename Func>
-	void for_each_cell(Func* f, int min_dimension, int max_dimension, vertex_index_t* prefix, int prefix_size = 0) {
-		prefix[prefix_size++] = vertex;
-		if (prefix_size >= min_dimension + 1) (*f)(prefix, prefix_size, data);
-		if (prefix_size == max_dimension + 1 || children == nullptr) return;
-
-		for (auto child : *children) child.second.for_each_cell(f, min_dimension, max_dimension, prefix, prefix_size);
+	template <typename Cell> void set_data(int dimension, const Cell vertices, ExtraData _data) {
+		levels[dimension].data[find_cell(dimension, vertices)] = _data;
 	}
-};
 
-template <typename ExtraData> struct euler_characteristic_computer_t {
-	void done() {}
-	void operator()(vertex_index_t* first_vertex, int size, ExtraData data) {
-		// Add (-1)^size to the Euler characteristic
-		if (size & 1)
-			ec++;
-		else
-			ec--;
+	template <typename Cell> const ExtraData& get_data(int dimension, const Cell vertices) const {
+		return levels[dimension].data[find_cell(dimension, vertices)];
 	}
 
-	index_t euler_characteristic() const { return ec; }
-
-private:
-	index_t ec = 0;
-};
-
-template <typename ExtraData> class directed_flag_complex_in_memory_t {
-public:
-	std::vector<directed_flag_complex_cell_in_memory_t<ExtraData>> vertex_cells;
-
-	directed_flag_complex_in_memory_t(const directed_graph_t& graph, int max_dimension = -1);
-	~directed_flag_complex_in_memory_t() {
-		for (auto p : vertex_cells) p.free_memory();
+	// Writes the positions of the cells (v_0, ..., v_k) into positions[k], for k = 0, ..., dimension
+	void find_prefixes(int dimension, const vertex_index_t* vertices, size_t* positions) const {
+		positions[0] = find_child(0, 0, vertices[0]);
+		for (int d = 1; d <= dimension; d++) positions[d] = find_child(d, positions[d - 1], vertices[d]);
 	}
 
-	template <typename Cell> void set_data(int dimension, const Cell vertices, ExtraData _data) {
-		vertex_cells[*vertices].set_data(dimension, vertices, _data);
+	// Gets the data of the coface that inserts the vertex before the index-th vertex of the cell, given the
+	// positions of the prefixes of the cell (see find_prefixes)
+	const ExtraData& get_coface_data(int dimension, const vertex_index_t* vertices, const size_t* prefix_positions,
+	                                 int index, vertex_index_t vertex) const {
+		size_t position = find_child(index, index > 0 ? prefix_positions[index - 1] : 0, vertex);
+		for (int d = index + 1; d <= dimension + 1; d++) position = find_child(d, position, vertices[d - 1]);
+		return levels[dimension + 1].data[position];
 	}
 
-	template <typename Cell> const ExtraData& get_data(int dimension, const Cell vertices) const {
-		return vertex_cells[vertices[0]].get_data(dimension, vertices);
+	// Frees the data of the cells of the given dimension, the cells themselves are kept as they are needed to find
+	// the cells of higher dimensions
+	void release_data(int dimension) {
+		if (dimension < levels.size()) std::vector<ExtraData>().swap(levels[dimension].data);
 	}
 
 	template <typename Func> void for_each_cell(Func& f, int min_dimension, int max_dimension = -1) {
@@ -128,16 +87,9 @@ public:
 	}
 
 	index_t euler_characteristic() {
-		std::array<euler_characteristic_computer_t<ExtraData>*, PARALLEL_THREADS> compute_euler_characteristic;
-		for (int i = 0; i < PARALLEL_THREADS; i++)
-			compute_euler_characteristic[i] = new euler_characteristic_computer_t<ExtraData>();
-
-		// TODO: Remove the 10000-hack
-		for_each_cell(compute_euler_characteristic, 0, 10000);
 		index_t euler_characteristic = 0;
-		for (int i = 0; i < PARALLEL_THREADS; i++)
-			euler_characteristic += compute_euler_characteristic[i]->euler_characteristic();
-
+		for (size_t dimension = 0; dimension < levels.size(); dimension++)
+			euler_characteristic += (dimension & 1 ? -1 : 1) * index_t(levels[dimension].vertices.size());
 		return euler_characteristic;
 	}
 
@@ -145,6 +97,16 @@ public:
 	void for_each_cell(std::array<Func*, number_of_threads>& fs, int min_dimension, int max_dimension = -1) {
 		if (max_dimension == -1) max_dimension = min_dimension;
 
+		for (int dimension = min_dimension; dimension <= max_dimension && dimension < levels.size(); dimension++)
+			if (levels[dimension].data.size() != levels[dimension].vertices.size())
+				levels[dimension].data.resize(levels[dimension].vertices.size());
+
+		if (!use_threads) {
+			for (int index = 0; index < number_of_threads; ++index)
+				worker_thread(number_of_threads, index, fs[index], min_dimension, max_dimension);
+			return;
+		}
+
 		std::thread t[number_of_threads - 1];
 
 		for (int index = 0; index < number_of_threads - 1; ++index)
@@ -161,64 +123,205 @@ public:
 
 	template <typename Func>
 	void worker_thread(int number_of_threads, int thread_id, Func* f, int min_dimension, int max_dimension) {
-		const size_t number_of_vertices = vertex_cells.size();
+		const size_t number_of_vertices = number_of_cells(0);
 
 		vertex_index_t prefix[max_dimension + 1];
 
-		for (vertex_index_t index = thread_id; index < number_of_vertices; index += number_of_threads) {
-			vertex_cells[index].for_each_cell(f, min_dimension, max_dimension, prefix);
-		}
+		for (vertex_index_t index = thread_id; index < number_of_vertices; index += number_of_threads)
+			for_each_cell_below(f, min_dimension, max_dimension, prefix, 0, index);
 
 		f->done();
 	}
+
+	// Returns the position of the cell in the level of its dimension, by a binary search in every level
+	template <typename Cell> size_t find_cell(int dimension, const Cell& vertices) const {
+		size_t position = find_child(0, 0, vertices[0]);
+		for (int d = 1; d <= dimension; d++) position = find_child(d, position, vertices[d]);
+		return position;
+	}
+
+	// Returns the position of the child with the given last vertex of the cell at the given position of the
+	// previous level. The cells of level 0 are the vertices.
+	size_t find_child(int dimension, size_t position, vertex_index_t vertex) const {
+		if (dimension >= levels.size()) cell_not_found();
+		if (dimension == 0) {
+			if (vertex >= levels[0].vertices.size()) cell_not_found();
+			return vertex;
+		}
+
+		const auto& level = levels[dimension];
+		const auto begin = level.vertices.begin() + levels[dimension - 1].children[position];
+		const auto end = level.vertices.begin() + levels[dimension - 1].children[position + 1];
+		const auto child = std::lower_bound(begin, end, vertex);
+		if (child == end || *child != vertex) cell_not_found();
+		return child - level.vertices.begin();
+	}
+
+private:
+	void cell_not_found() const {
+		std::cerr << "A cell could not be found in the directed flag complex." << std::endl;
+		exit(-1);
+	}
+
+	template <typename Func>
+	void for_each_cell_below(Func* f, int min_dimension, int max_dimension, vertex_index_t* prefix, int dimension,
+	                         size_t position) {
+		auto& level = levels[dimension];
+		prefix[dimension] = level.vertices[position];
+		if (dimension >= min_dimension) (*f)(prefix, dimension + 1, level.data[position]);
+		if (dimension == max_dimension || dimension + 1 == levels.size()) return;
+
+		for (size_t child = level.children[position]; child < level.children[position + 1]; child++)
+			for_each_cell_below(f, min_dimension, max_dimension, prefix, dimension + 1, child);
+	}
 };
 
-template <typename ExtraData>
-void construct_children(directed_flag_complex_cell_in_memory_t<ExtraData>& current_cell, const directed_graph_t& graph,
-                        const std::vector<vertex_index_t>& possible_next_vertices, int max_dimension,
-                        int current_dimension = 0) {
-	if (current_dimension == max_dimension) return;
+// Gets the faces of a sequence of cells. Consecutive cells of for_each_cell share a prefix, and the faces of them
+// share the corresponding prefixes: the positions of the prefixes of all faces are kept, so that only the vertices
+// behind the common prefix with the previous cell are searched again.
+template <typename ExtraData> class directed_flag_complex_face_finder_t {
+	const directed_flag_complex_in_memory_t<ExtraData>& complex;
+	int dimension = -1;
+	std::vector<vertex_index_t> previous_cell;
+	// The positions of the prefixes (v_0, ..., v_j) of the cell
+	std::vector<size_t> prefix_positions;
+	// The positions of the prefixes (w_0, ..., w_j) of the faces, where w is the cell without the i-th vertex,
+	// at face_prefix_positions[i * dimension + j]
+	std::vector<size_t> face_prefix_positions;
 
-	for (auto vertex : possible_next_vertices) {
-		if (vertex == current_cell.vertex) continue;
+public:
+	directed_flag_complex_face_finder_t(const directed_flag_complex_in_memory_t<ExtraData>& _complex)
+	    : complex(_complex) {}
+
+	// Gets the data of all faces of the cell, faces[i] is the data of the face without the i-th vertex
+	void get_face_data(int _dimension, const vertex_index_t* vertices, const ExtraData** faces) {
+		// The length of the common prefix with the previous cell
+		int common = 0;
+		if (_dimension == dimension) {
+			while (common <= dimension && vertices[common] == previous_cell[common]) common++;
+		} else {
+			dimension = _dimension;
+			previous_cell.resize(dimension + 1);
+			prefix_positions.resize(dimension);
+			face_prefix_positions.resize((dimension + 1) * dimension);
+		}
 
-		// Compute the next elements
-		std::vector<vertex_index_t> new_possible_vertices;
-		for (auto v : possible_next_vertices)
-			if (v != vertex && v != current_cell.vertex && graph.is_connected_by_an_edge(vertex, v))
-				new_possible_vertices.push_back(v);
+		for (int j = common; j < dimension; j++)
+			prefix_positions[j] = complex.find_child(j, j > 0 ? prefix_positions[j - 1] : 0, vertices[j]);
+
+		const auto& level = complex.levels[dimension - 1];
+		for (int i = 0; i < dimension; i++) {
+			// The prefixes of the face are the ones of the cell before the i-th vertex, the following ones are
+			// still valid if the vertex behind them did not change
+			size_t* positions = &face_prefix_positions[i * dimension];
+			for (int j = std::max(i, common - 1); j < dimension; j++) {
+				const size_t parent = j == 0 ? 0 : j == i ? prefix_positions[j - 1] : positions[j - 1];
+				positions[j] = complex.find_child(j, parent, vertices[j + 1]);
+			}
+			faces[i] = &level.data[positions[dimension - 1]];
+		}
+		faces[dimension] = &level.data[prefix_positions[dimension - 1]];
 
-		directed_flag_complex_cell_in_memory_t<ExtraData>& new_cell = current_cell.add_child(vertex);
-		construct_children(new_cell, graph, new_possible_vertices, max_dimension, current_dimension + 1);
+		std::copy(vertices, vertices + dimension + 1, previous_cell.begin());
 	}
-}
+};
 
-template <typename ExtraData>
-void construction_worker_thread(int number_of_threads, int thread_id,
-                                directed_flag_complex_in_memory_t<ExtraData>* result, const directed_graph_t* graph,
-                                int max_dimension) {
-	const size_t number_of_vertices = graph->vertex_number();
-
-	for (size_t index = thread_id; index < number_of_vertices; index += number_of_threads) {
-		// Compute possible vertices
-		std::vector<vertex_index_t> possible_vertices;
-		for (size_t offset = 0; offset < graph->incidence_row_length; offset++) {
-			size_t bits = graph->get_outgoing_chunk(index, offset);
-			;
-			size_t vertex_offset = offset << 6;
+// Enumerates the cells below the edges of a task depth-first. In the first pass the cells of every dimension are
+// only counted, in the second pass they are written into the levels of the complex, starting at the given
+// positions. The candidate vertices of every dimension are kept between the cells, so the construction does not
+// allocate memory per cell.
+template <typename ExtraData> class directed_flag_complex_in_memory_builder_t {
+	const directed_graph_t& graph;
+	directed_flag_complex_in_memory_t<ExtraData>& complex;
+	int max_dimension;
+	// The vertices that can be appended to the current cell of every dimension
+	std::vector<std::vector<vertex_index_t>> possible_next_vertices;
+	bool fill = false;
 
-			while (bits > 0) {
-				// Get the least significant non-zero bit
-				int b = __builtin_ctzl(bits);
+public:
+	// The number of cells of every dimension, or the next free position in every level
+	std::vector<size_t> positions;
+
+	directed_flag_complex_in_memory_builder_t(const directed_graph_t& _graph,
+	                                          directed_flag_complex_in_memory_t<ExtraData>& _complex,
+	                                          int _max_dimension)
+	    : graph(_graph), complex(_complex), max_dimension(_max_dimension) {}
+
+	void count(size_t first_edge, size_t last_edge) {
+		fill = false;
+		positions.clear();
+		visit_edges(first_edge, last_edge);
+	}
 
-				// Unset this bit
-				bits &= ~(1UL << b);
-				possible_vertices.push_back(vertex_offset + b);
+	void write(size_t first_edge, size_t last_edge, const std::vector<size_t>& start_positions) {
+		fill = true;
+		positions = start_positions;
+		visit_edges(first_edge, last_edge);
+	}
+
+private:
+	// Visits the edges at the positions [first_edge, last_edge) of level 1
+	void visit_edges(size_t first_edge, size_t last_edge) {
+		const auto& vertices = complex.levels[0];
+		const auto& edges = complex.levels[1];
+		if (possible_next_vertices.size() < 2) possible_next_vertices.resize(2);
+
+		// The source of the first edge, the last vertex whose edges start before it
+		vertex_index_t vertex = std::upper_bound(vertices.children.begin(), vertices.children.end(), first_edge) -
+		                        vertices.children.begin() - 1;
+		for (size_t edge = first_edge; edge < last_edge; edge++) {
+			while (vertices.children[vertex + 1] <= edge) vertex++;
+			const vertex_index_t next_vertex = edges.vertices[edge];
+
+			// The cofaces of the edge append the common out-neighbours of both vertices
+			auto& new_possible_vertices = possible_next_vertices[1];
+			new_possible_vertices.clear();
+			for (size_t j = vertices.children[vertex]; j < vertices.children[vertex + 1]; j++) {
+				const vertex_index_t v = edges.vertices[j];
+				if (v != next_vertex && graph.is_connected_by_an_edge(next_vertex, v))
+					new_possible_vertices.push_back(v);
 			}
+
+			visit(1, edge, next_vertex);
 		}
-		construct_children(result->vertex_cells[index], *graph, possible_vertices, max_dimension);
 	}
-}
+
+	void add_cell(int dimension, vertex_index_t vertex) {
+		if (positions.size() <= dimension) positions.resize(dimension + 1, 0);
+		const size_t position = positions[dimension]++;
+		if (fill) complex.levels[dimension].vertices[position] = vertex;
+	}
+
+	void visit(int dimension, size_t position, vertex_index_t vertex) {
+		if (possible_next_vertices.size() <= dimension + 1) possible_next_vertices.resize(dimension + 2);
+
+		const bool has_children = dimension != max_dimension;
+		const size_t first_child = positions.size() > dimension + 1 ? positions[dimension + 1] : 0;
+		if (fill) complex.levels[dimension].children[position] = first_child;
+		if (!has_children) return;
+
+		// The possible next vertices are sorted, so the children are added in increasing order
+		const size_t number_of_possible_vertices = possible_next_vertices[dimension].size();
+		for (size_t i = 0; i < number_of_possible_vertices; i++)
+			add_cell(dimension + 1, possible_next_vertices[dimension][i]);
+
+		size_t child = first_child;
+		for (size_t i = 0; i < number_of_possible_vertices; i++) {
+			const vertex_index_t next_vertex = possible_next_vertices[dimension][i];
+
+			// Compute the next elements
+			auto& new_possible_vertices = possible_next_vertices[dimension + 1];
+			new_possible_vertices.clear();
+			for (size_t j = 0; j < number_of_possible_vertices; j++) {
+				const vertex_index_t v = possible_next_vertices[dimension][j];
+				if (v != next_vertex && graph.is_connected_by_an_edge(next_vertex, v))
+					new_possible_vertices.push_back(v);
+			}
+
+			visit(dimension + 1, child++, next_vertex);
+		}
+	}
+};
 
 template <typename ExtraData>
 directed_flag_complex_in_memory_t<ExtraData>::directed_flag_complex_in_memory_t(const directed_graph_t& graph,
@@ -228,22 +331,115 @@ directed_flag_complex_in_memory_t<ExtraData>::directed_flag_complex_in_memory_t(
 	          << "constructing the directed flag complex" << std::flush << "\r";
 #endif
 
-	// First we add the vertices of the directed flag complex
-	vertex_cells.reserve(graph.number_of_vertices);
-	for (vertex_index_t index = 0; index < graph.number_of_vertices; index++)
-		vertex_cells.push_back(directed_flag_complex_cell_in_memory_t<ExtraData>(index));
+	use_threads = !compute_serially() && graph.edge_number() >= MINIMAL_EDGES_FOR_THREADS;
+	const size_t number_of_vertices = graph.vertex_number();
+
+	// Runs f(thread, task) for all tasks, every thread takes the next task as soon as it is done with one, so that
+	// vertices with many cells below them do not keep a single thread busy while the others are idle
+	const auto for_each_task = [this](size_t number_of_tasks, const std::function<void(int, size_t)>& f) {
+		std::atomic<size_t> next_task(0);
+		const auto work = [&](int thread) {
+			for (size_t task; (task = next_task++) < number_of_tasks;) f(thread, task);
+		};
+		if (!use_threads) return work(0);
+
+		std::vector<std::thread> threads;
+		for (int t = 0; t < PARALLEL_THREADS; t++) threads.push_back(std::thread(work, t));
+		for (auto& thread : threads) thread.join();
+	};
+
+	// The out-neighbours of a vertex in increasing order, without the vertex itself
+	const auto for_each_out_neighbour = [&graph](vertex_index_t vertex, const std::function<void(vertex_index_t)>& f) {
+		for (size_t offset = 0; offset < graph.incidence_row_length; offset++) {
+			size_t bits = graph.get_outgoing_chunk(vertex, offset);
+			size_t vertex_offset = offset << 6;
 
-	// Now we start a few threads to construct the flag complex
-	std::thread t[PARALLEL_THREADS - 1];
+			while (bits > 0) {
+				// Get the least significant non-zero bit
+				int b = __builtin_ctzl(bits);
 
-	for (int index = 0; index < PARALLEL_THREADS - 1; ++index)
-		t[index] =
-		    std::thread(&construction_worker_thread<ExtraData>, PARALLEL_THREADS, index, this, &graph, max_dimension);
+				// Unset this bit
+				bits &= ~(1UL << b);
+				if (vertex_offset + b != vertex) f(vertex_offset + b);
+			}
+		}
+	};
+
+	// The vertices and edges are read directly from the graph
+	const size_t number_of_vertex_tasks =
+	    (number_of_vertices + IN_MEMORY_CONSTRUCTION_TASK_SIZE - 1) / IN_MEMORY_CONSTRUCTION_TASK_SIZE;
+	const auto for_each_vertex = [&](const std::function<void(vertex_index_t)>& f) {
+		for_each_task(number_of_vertex_tasks, [&](int, size_t task) {
+			const size_t last = std::min(number_of_vertices, (task + 1) * IN_MEMORY_CONSTRUCTION_TASK_SIZE);
+			for (size_t v = task * IN_MEMORY_CONSTRUCTION_TASK_SIZE; v < last; v++) f(v);
+		});
+	};
+
+	levels.resize(max_dimension == 0 ? 1 : 2);
+	levels[0].vertices.resize(number_of_vertices);
+	levels[0].children.resize(number_of_vertices + 1, 0);
+	levels[0].data.resize(number_of_vertices);
+	for (size_t v = 0; v < number_of_vertices; v++) levels[0].vertices[v] = v;
+	if (max_dimension == 0) return;
+
+	for_each_vertex([&](vertex_index_t v) {
+		for_each_out_neighbour(v, [&](vertex_index_t) { levels[0].children[v + 1]++; });
+	});
+	for (size_t v = 0; v < number_of_vertices; v++) levels[0].children[v + 1] += levels[0].children[v];
+
+	const size_t number_of_edges = levels[0].children.back();
+	levels[1].vertices.resize(number_of_edges);
+	levels[1].data.resize(number_of_edges);
+	for_each_vertex([&](vertex_index_t v) {
+		size_t position = levels[0].children[v];
+		for_each_out_neighbour(v, [&](vertex_index_t w) { levels[1].vertices[position++] = w; });
+	});
+
+	// The cells of higher dimensions are constructed in tasks of consecutive edges. The cells below these edges are
+	// consecutive in every level, so the first pass counts them for every task, and the second pass writes them.
+	const size_t number_of_tasks =
+	    (number_of_edges + IN_MEMORY_CONSTRUCTION_TASK_SIZE - 1) / IN_MEMORY_CONSTRUCTION_TASK_SIZE;
+	std::vector<std::vector<size_t>> cells_below_task(number_of_tasks);
+	std::vector<directed_flag_complex_in_memory_builder_t<ExtraData>> builders(
+	    PARALLEL_THREADS, directed_flag_complex_in_memory_builder_t<ExtraData>(graph, *this, max_dimension));
+
+	for (int pass = 0; pass < 2; pass++) {
+		const bool fill = pass == 1;
+		if (fill) {
+			// Allocate the levels and compute where the cells of every task start. Every task gets a start
+			// position in all levels (and one behind them), also the tasks without cells in there.
+			size_t number_of_levels = 2;
+			for (const auto& cells : cells_below_task) number_of_levels = std::max(number_of_levels, cells.size());
+
+			std::vector<size_t> total(number_of_levels + 1, 0);
+			for (auto& cells : cells_below_task) {
+				cells.resize(number_of_levels + 1, 0);
+				for (size_t dimension = 2; dimension <= number_of_levels; dimension++) {
+					const size_t count = cells[dimension];
+					cells[dimension] = total[dimension];
+					total[dimension] += count;
+				}
+			}
 
-	// Also do work in this thread, namely the last bit
-	// For this last thread, take all the remaining vertices
-	construction_worker_thread(PARALLEL_THREADS, PARALLEL_THREADS - 1, this, &graph, max_dimension);
+			levels.resize(number_of_levels);
+			levels[1].children.resize(number_of_edges + 1);
+			for (size_t dimension = 2; dimension < number_of_levels; dimension++) {
+				levels[dimension].vertices.resize(total[dimension]);
+				levels[dimension].children.resize(total[dimension] + 1);
+			}
+			for (size_t dimension = 1; dimension < number_of_levels; dimension++)
+				levels[dimension].children.back() = total[dimension + 1];
+		}
 
-	// Wait until all threads stopped
-	for (int i = 0; i < PARALLEL_THREADS - 1; ++i) t[i].join();
-}
\ No newline at end of file
+		for_each_task(number_of_tasks, [&](int thread, size_t task) {
+			const size_t first_edge = task * IN_MEMORY_CONSTRUCTION_TASK_SIZE;
+			const size_t last_edge = std::min(number_of_edges, first_edge + IN_MEMORY_CONSTRUCTION_TASK_SIZE);
+			if (fill) {
+				builders[thread].write(first_edge, last_edge, cells_below_task[task]);
+			} else {
+				builders[thread].count(first_edge, last_edge);
+				cells_below_task[task] = builders[thread].positions;
+			}
+		});
+	}
+}
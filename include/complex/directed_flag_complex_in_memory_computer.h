@@ -4,58 +4,46 @@
 
 #include <algorithm>
 #include <array>
+#include <memory>
 
 #include "../argparser.h"
 #include "../directed_graph.h"
 #include "../filtration_algorithms.h"
 #include "../persistence.h"
 
+#include "coboundary_cache.h"
 #include "directed_flag_complex_in_memory.h"
 
 template <typename Complex> class coboundary_iterator_t {
 	const Complex* complex;
 	short dimension;
-	const compressed_sparse_matrix<entry_t>& matrix;
-	const index_t index;
+	const entry_t* current = nullptr;
+	const entry_t* end = nullptr;
   const coefficient_t coefficient;
   const coefficient_t modulus;
-	size_t current_offset = 0;
 
 public:
-	coboundary_iterator_t(const Complex* _complex, short _dimension, const compressed_sparse_matrix<entry_t>& _matrix,
-	                      index_t _index, coefficient_t _coefficient, coefficient_t _modulus)
-	    : complex(_complex), dimension(_dimension), matrix(_matrix), index(_index), coefficient(_coefficient), modulus(_modulus) {}
+	coboundary_iterator_t(const Complex* _complex, short _dimension, const compressed_sparse_matrix<entry_t>& matrix,
+	                      index_t index, coefficient_t _coefficient, coefficient_t _modulus)
+	    : complex(_complex), dimension(_dimension), coefficient(_coefficient), modulus(_modulus) {
+		if (index == -1) return;
+		current = matrix.cbegin(index);
+		end = matrix.cend(index);
+	}
 
-	bool has_next() { return index != -1 && matrix.cbegin(index) + current_offset != matrix.cend(index); }
+	bool has_next() { return current != end; }
 
 	filtration_entry_t next() {
-		entry_t entry = *(matrix.cbegin(index) + current_offset++);
+		entry_t entry = *current++;
     coefficient_t coface_coefficient = get_coefficient(entry) * coefficient % modulus;
 		return filtration_entry_t(complex->filtration(dimension + 1, get_index(entry)), get_index(entry), coface_coefficient);
 	}
 };
 
-struct reorder_edges_t {
-	reorder_edges_t(std::vector<vertex_index_t>& _new_edges, std::vector<value_t>& _new_filtration,
-	                bool _reorder_filtration)
-	    : new_edges(_new_edges), new_filtration(_new_filtration), reorder_filtration(_reorder_filtration) {}
-	void done() {}
-	void operator()(vertex_index_t* first_vertex, int size, std::pair<index_t, value_t>& data) {
-		new_edges.push_back(*first_vertex++);
-		new_edges.push_back(*first_vertex);
-		if (reorder_filtration) new_filtration.push_back(data.second);
-	}
-
-private:
-	std::vector<vertex_index_t>& new_edges;
-	std::vector<value_t>& new_filtration;
-	bool reorder_filtration;
-};
-
 struct compute_filtration_t {
 	compute_filtration_t(filtration_algorithm_t* _filtration_algorithm, filtered_directed_graph_t& _graph,
 	                     directed_flag_complex_in_memory_t<std::pair<index_t, value_t>>& _complex)
-	    : filtration_algorithm(_filtration_algorithm), graph(_graph), complex(_complex) {}
+	    : filtration_algorithm(_filtration_algorithm), graph(_graph), face_finder(_complex) {}
 	void done() {}
 	void operator()(vertex_index_t* first_vertex, int size, std::pair<index_t, value_t>& data) {
 		// The index starts at -1, so the first cell gets index 0
@@ -69,10 +57,10 @@ struct compute_filtration_t {
 
 			if (filtration_algorithm->needs_face_filtration()) {
 				if (boundary_filtration == nullptr) boundary_filtration = new value_t[size];
+				faces.resize(size);
 
-				for (int i = 0; i < size; i++) {
-					boundary_filtration[i] = complex.get_data(size - 2, cell.boundary(i)).second;
-				}
+				face_finder.get_face_data(size - 1, first_vertex, faces.data());
+				for (int i = 0; i < size; i++) boundary_filtration[i] = faces[i]->second;
 
 				nf = filtration_algorithm->compute_filtration(size - 1, cell, graph, boundary_filtration);
 			} else {
@@ -80,7 +68,7 @@ struct compute_filtration_t {
 			}
 			next_filtration.push_back(nf);
 		}
-		complex.set_data(size - 1, first_vertex, std::make_pair(current_index, nf));
+		data = std::make_pair(current_index, nf);
 	}
 
 	std::vector<value_t> filtration() const { return next_filtration; }
@@ -90,15 +78,16 @@ struct compute_filtration_t {
 private:
 	index_t current_index = -1;
 	filtration_algorithm_t* filtration_algorithm;
-	directed_flag_complex_in_memory_t<std::pair<index_t, value_t>>& complex;
 	filtered_directed_graph_t& graph;
 
 	value_t* boundary_filtration = nullptr;
+	directed_flag_complex_face_finder_t<std::pair<index_t, value_t>> face_finder;
+	std::vector<const std::pair<index_t, value_t>*> faces;
 	std::vector<value_t> next_filtration;
 };
 
 template <typename Complex>
-void prepare_graph_filtration(Complex& complex, filtered_directed_graph_t& graph,
+void prepare_graph_filtration(Complex* complex, filtered_directed_graph_t& graph,
                               filtration_algorithm_t* filtration_algorithm) {
 	if (filtration_algorithm == nullptr) {
 		// All vertices get the trivial filtration value
@@ -122,37 +111,24 @@ void prepare_graph_filtration(Complex& complex, filtered_directed_graph_t& graph
 		          << "computing the filtration of all edges" << std::flush << "\r";
 #endif
 
-		compute_filtration_t compute_filtration(filtration_algorithm, graph, complex);
-		complex.for_each_cell(compute_filtration, 1);
+		compute_filtration_t compute_filtration(filtration_algorithm, graph, *complex);
+		complex->for_each_cell(compute_filtration, 1);
 		graph.edge_filtration.clear();
 		graph.edge_filtration = compute_filtration.filtration();
 	}
 
-	// Reorder the edge filtration
+	// Store the given edge filtration in the complex
 	if (!computed_edge_filtration && filtration_algorithm != nullptr) {
 		vertex_index_t* edge = &graph.edges[0];
 		value_t* filtration = &graph.edge_filtration[0];
 		for (size_t index = 0; index < graph.edge_number(); ++index, edge += 2, ++filtration) {
-			complex.set_data(1, edge, std::make_pair(-1, *filtration));
+			complex->set_data(1, edge, std::make_pair(-1, *filtration));
 		}
 	}
 
-	// Now reorder the edges
-	std::vector<vertex_index_t> new_edges[PARALLEL_THREADS];
-	std::vector<value_t> new_filtrations[PARALLEL_THREADS];
-	std::array<reorder_edges_t*, PARALLEL_THREADS> reorder_filtration;
-	for (int i = 0; i < PARALLEL_THREADS; i++)
-		reorder_filtration[i] = new reorder_edges_t(new_edges[i], new_filtrations[i],
-		                                            !computed_edge_filtration && filtration_algorithm != nullptr);
-	complex.for_each_cell(reorder_filtration, 1);
-
-	size_t current_filtration_index = 0;
-	size_t current_edge_index = 0;
-	for (int i = 0; i < PARALLEL_THREADS; i++) {
-		for (auto e : new_edges[i]) graph.edges[current_edge_index++] = e;
-		if (!computed_edge_filtration && filtration_algorithm != nullptr)
-			for (auto f : new_filtrations[i]) graph.edge_filtration[current_filtration_index++] = f;
-	}
+	// Now, we reorder the edges and their filtration value such that it matches
+	// the iteration order of "for_each_cell"
+	graph.sort_edges_in_enumeration_order(PARALLEL_THREADS, !computed_edge_filtration && filtration_algorithm != nullptr);
 }
 
 class directed_flag_complex_in_memory_computer_t {
@@ -164,9 +140,13 @@ class directed_flag_complex_in_memory_computer_t {
 	int current_dimension = 0;
 	bool _is_top_dimension = false;
 	std::vector<size_t> cell_count;
-	const char* cache;
+	std::string cache;
+	coboundary_cache_key_t cache_key;
 
-	directed_flag_complex_in_memory_t<std::pair<index_t, value_t>> flag_complex;
+	// Only constructed once it is needed, so that runs that find everything in the cache skip the construction
+	std::unique_ptr<directed_flag_complex_in_memory_t<std::pair<index_t, value_t>>> flag_complex;
+	// The highest dimension whose cells carry their index and filtration in the complex
+	int indexed_dimension = 1;
 
 	// Filtration
 	std::vector<value_t> next_filtration;
@@ -179,7 +159,7 @@ class directed_flag_complex_in_memory_computer_t {
 public:
 	directed_flag_complex_in_memory_computer_t(filtered_directed_graph_t& _graph,
 	                                           const named_arguments_t& named_arguments)
-	    : graph(_graph), flag_complex(graph),
+	    : graph(_graph),
 	      filtration_algorithm(get_filtration_computer(get_argument_or_default(named_arguments, "filtration", "zero"))),
 	      min_dimension(atoi(get_argument_or_default(named_arguments, "min-dim", "0"))),
 	      max_dimension(atoi(get_argument_or_default(named_arguments, "max-dim", "65535"))),
@@ -188,9 +168,16 @@ public:
 		cell_count.push_back(_graph.vertex_number());
 		cell_count.push_back(_graph.edge_number());
 
+		if (cache != "")
+			cache_key = coboundary_cache_key(get_argument_or_default(named_arguments, "filtration", "zero"), modulus,
+			                                 graph);
+
 		// Order the edges and compute the correct filtration
-		if (min_dimension <= 1 || (filtration_algorithm != nullptr && filtration_algorithm->needs_face_filtration()))
-			prepare_graph_filtration(flag_complex, graph, filtration_algorithm);
+		if (min_dimension <= 1 || (filtration_algorithm != nullptr && filtration_algorithm->needs_face_filtration())) {
+			// The filtration of the edges is computed and stored in the complex
+			if (filtration_algorithm != nullptr) build_complex();
+			prepare_graph_filtration(flag_complex.get(), graph, filtration_algorithm);
+		}
 	}
 
 	size_t number_of_cells(int dimension) const {
@@ -220,6 +207,19 @@ public:
 	// Note: Gets called with consecutive dimensions, starting with zero
 	void prepare_next_dimension(int dimension);
 
+private:
+	// The coboundaries of the highest dimension need the cells one dimension above it, the cells of higher
+	// dimensions are never constructed
+	void build_complex() {
+		if (flag_complex == nullptr)
+			flag_complex.reset(new directed_flag_complex_in_memory_t<std::pair<index_t, value_t>>(
+			    graph, max_dimension + 1));
+	}
+
+	void restore_filtration(int dimension);
+
+public:
+
 	inline coboundary_iterator_t<directed_flag_complex_in_memory_computer_t> coboundary(filtration_entry_t cell) {
 		if (current_dimension > max_dimension || is_top_dimension()) {
 			return coboundary_iterator_t<directed_flag_complex_in_memory_computer_t>(this, current_dimension,
@@ -265,12 +265,15 @@ struct store_coboundaries_in_cache_t {
 			std::cout << " coboundaries" << std::flush << "\r";
 		}
 #endif
-		directed_flag_complex_cell_t cell(first_vertex);
 		coboundary_matrix.append_column();
 
-		std::vector<size_t> vertex_offsets;
+		vertex_offsets.clear();
 		for (int j = 0; j < size; j++) vertex_offsets.push_back(first_vertex[j] >> 6);
 
+		// The cofaces share the prefixes with the cell, so these are only looked up once
+		prefix_positions.resize(size);
+		complex.find_prefixes(size - 1, first_vertex, prefix_positions.data());
+
 		for (int i = 0; i <= size; i++) {
 			// Check intersections in chunks of 64
 			for (size_t offset = 0; offset < graph.incidence_row_length; offset++) {
@@ -294,11 +297,12 @@ struct store_coboundaries_in_cache_t {
 					bits &= ~(1UL << b);
 
 					// Now insert the appropriate vertex at this position
-					auto cb = cell.insert_vertex(i, vertex_offset + b);
-					short thread_index = cb.vertex(0) % PARALLEL_THREADS;
+					const vertex_index_t vertex = vertex_offset + b;
+					short thread_index = (i == 0 ? vertex : first_vertex[0]) % PARALLEL_THREADS;
+					const auto& coface =
+					    complex.get_coface_data(current_dimension, first_vertex, prefix_positions.data(), i, vertex);
 					coboundary_matrix.push_back(
-					    make_entry(complex.get_data(current_dimension + 1, cb).first + cell_index_offsets[thread_index],
-					               i & 1 ? -1 + modulus : 1));
+					    make_entry(coface.first + cell_index_offsets[thread_index], i & 1 ? -1 + modulus : 1));
 				}
 			}
 		}
@@ -311,6 +315,8 @@ private:
 	bool is_first;
 	int current_dimension;
 	compressed_sparse_matrix<entry_t>& coboundary_matrix;
+	std::vector<size_t> vertex_offsets;
+	std::vector<size_t> prefix_positions;
 	bool is_cache_presized = false;
 	const filtered_directed_graph_t& graph;
 	const directed_flag_complex_in_memory_t<std::pair<index_t, value_t>>& complex;
@@ -329,10 +335,33 @@ void directed_flag_complex_in_memory_computer_t::prepare_next_dimension(int dime
 
 	for (int i = 0; i < PARALLEL_THREADS; i++) { coboundary_matrix[i].clear(); }
 
-	if (dimension > max_dimension || _is_top_dimension) return;
+	if (dimension > max_dimension || _is_top_dimension) {
+		flag_complex.reset();
+		return;
+	}
 
 	vertex_index_t vertices_per_thread = graph.number_of_vertices / PARALLEL_THREADS;
 
+	if (cache != "" && load_cached_coboundaries(cache, cache_key, current_dimension, cell_count[current_dimension],
+	                                            filtration_algorithm != nullptr, coboundary_matrix,
+	                                            coboundary_matrix_offsets, cell_count[current_dimension + 1],
+	                                            next_filtration)) {
+		// The top dimension is stored without coboundaries
+		size_t columns = 0;
+		for (auto& matrix : coboundary_matrix) columns += matrix.size();
+		if (columns > 0) cell_count[current_dimension] = columns;
+		_is_top_dimension = cell_count[current_dimension + 1] == 0;
+		return;
+	}
+
+	build_complex();
+	if (filtration_algorithm != nullptr && filtration_algorithm->needs_face_filtration() &&
+	    indexed_dimension < dimension)
+		restore_filtration(dimension);
+
+	// Only the cells of this dimension (as faces) and of the next one (as cofaces) still need their data
+	for (int d = 0; d < dimension; d++) flag_complex->release_data(d);
+
 	{
 		size_t _next_cells_offsets[PARALLEL_THREADS];
 		{
@@ -348,9 +377,10 @@ void directed_flag_complex_in_memory_computer_t::prepare_next_dimension(int dime
 				size_t offset = 0;
 				std::array<compute_filtration_t*, PARALLEL_THREADS> compute_filtration;
 				for (int i = 0; i < PARALLEL_THREADS; i++) {
-					compute_filtration[i] = new compute_filtration_t(filtration_algorithm, graph, flag_complex);
+					compute_filtration[i] = new compute_filtration_t(filtration_algorithm, graph, *flag_complex);
 				}
-				flag_complex.for_each_cell(compute_filtration, dimension + 1);
+				flag_complex->for_each_cell(compute_filtration, dimension + 1);
+				indexed_dimension = dimension + 1;
 
 				size_t _cell_count = 0;
 				for (int i = 0; i < PARALLEL_THREADS; i++) {
@@ -386,13 +416,28 @@ void directed_flag_complex_in_memory_computer_t::prepare_next_dimension(int dime
 
 			// Now compute the coboundaries
 			std::array<store_coboundaries_in_cache_t*, PARALLEL_THREADS> store_coboundaries;
-			for (int i = 0; i < PARALLEL_THREADS; i++) coboundary_matrix[i] = compressed_sparse_matrix<entry_t>();
+			// The thread of a cell is given by its first vertex. The cofaces of a cell start with the same vertex,
+			// except the one that puts a vertex in front, which then is the second vertex of the coface
+			size_t columns[PARALLEL_THREADS] = {}, entries[PARALLEL_THREADS] = {};
+			for (vertex_index_t v = 0; v < graph.number_of_vertices; v++) {
+				columns[v % PARALLEL_THREADS] += flag_complex->number_of_cells_below(dimension, 0, v);
+				entries[v % PARALLEL_THREADS] +=
+				    (dimension + 1) * flag_complex->number_of_cells_below(dimension + 1, 0, v);
+			}
+			for (size_t e = 0; e < flag_complex->number_of_cells(1); e++)
+				entries[flag_complex->levels[1].vertices[e] % PARALLEL_THREADS] +=
+				    flag_complex->number_of_cells_below(dimension + 1, 1, e);
+
+			for (int i = 0; i < PARALLEL_THREADS; i++) {
+				coboundary_matrix[i] = compressed_sparse_matrix<entry_t>();
+				coboundary_matrix[i].reserve(columns[i], entries[i]);
+			}
 			for (int i = 0; i < PARALLEL_THREADS; i++) {
 				store_coboundaries[i] = new store_coboundaries_in_cache_t(
-				    coboundary_matrix[i], dimension, graph, flag_complex, _next_cells_offsets, cell_count[dimension],
+				    coboundary_matrix[i], dimension, graph, *flag_complex, _next_cells_offsets, cell_count[dimension],
 				    i == 0, vertices_per_thread, modulus);
 			}
-			flag_complex.for_each_cell(store_coboundaries, dimension);
+			flag_complex->for_each_cell(store_coboundaries, dimension);
 
 			size_t _cell_count = 0;
 			for (int i = 0; i < PARALLEL_THREADS; i++) {
@@ -403,6 +448,50 @@ void directed_flag_complex_in_memory_computer_t::prepare_next_dimension(int dime
 
 			// Cleanup
 			for (int i = 0; i < PARALLEL_THREADS; i++) delete store_coboundaries[i];
+		} else {
+			for (int i = 0; i < PARALLEL_THREADS; i++) coboundary_matrix_offsets[i] = 0;
 		}
 	}
+
+	// The remaining dimensions are reduced from the coboundaries alone
+	if (dimension >= max_dimension || _is_top_dimension) flag_complex.reset();
+
+	if (cache != "")
+		cache_coboundaries(cache, cache_key, current_dimension, coboundary_matrix, coboundary_matrix_offsets,
+		                   cell_count[current_dimension + 1], next_filtration);
+}
+
+struct restore_cell_filtration_t {
+	restore_cell_filtration_t(const std::vector<value_t>& _filtration, size_t _offset)
+	    : filtration(_filtration), offset(_offset) {}
+	void done() {}
+	void operator()(vertex_index_t* first_vertex, int size, std::pair<index_t, value_t>& data) {
+		data.second = filtration[offset + data.first];
+	}
+
+private:
+	const std::vector<value_t>& filtration;
+	size_t offset;
+};
+
+// If the previous dimension was loaded from the cache, the cells of this dimension do not carry their
+// filtration yet, which is needed for the filtration of their cofaces
+void directed_flag_complex_in_memory_computer_t::restore_filtration(int dimension) {
+	std::array<compute_filtration_t*, PARALLEL_THREADS> index_cells;
+	for (int i = 0; i < PARALLEL_THREADS; i++) index_cells[i] = new compute_filtration_t(nullptr, graph, *flag_complex);
+	flag_complex->for_each_cell(index_cells, dimension);
+
+	size_t offset = 0;
+	std::array<restore_cell_filtration_t*, PARALLEL_THREADS> restore;
+	for (int i = 0; i < PARALLEL_THREADS; i++) {
+		restore[i] = new restore_cell_filtration_t(next_filtration, offset);
+		offset += index_cells[i]->number_of_cells();
+	}
+	flag_complex->for_each_cell(restore, dimension);
+
+	for (int i = 0; i < PARALLEL_THREADS; i++) {
+		delete index_cells[i];
+		delete restore[i];
+	}
+	indexed_dimension = dimension;
 }
@@ -2,11 +2,26 @@
 
 #include <algorithm>
 #include <iostream>
+#include <limits>
 #include <string>
 #include <unordered_map>
 
 // #define USE_GOOGLE_HASHMAP
 #define PARALLEL_THREADS 8
+// For smaller graphs, the work of all threads is done in the calling thread
+#define MINIMAL_EDGES_FOR_THREADS 1000
+#define MINIMAL_COLUMNS_FOR_THREADS 10000
+// With --components, components of at least this many vertices and edges together are computed one after the
+// other using all threads, the smaller ones are computed at the same time, each of them by a single thread
+#define LARGE_COMPONENT_SIZE 10000
+// Set in threads that run next to PARALLEL_THREADS others, these do all their work themselves
+// instead of starting more threads
+inline bool& compute_serially() {
+	static thread_local bool serially = false;
+	return serially;
+}
+// The in-memory complex is constructed in tasks of this many edges, that the threads take one after another
+#define IN_MEMORY_CONSTRUCTION_TASK_SIZE 64
 
 #ifndef MANY_VERTICES
 // Assume that we have at most 65k vertices, and that there are at most ~2 billion cells
@@ -1,14 +1,54 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <deque>
+#include <functional>
+#include <limits>
 #include <sstream>
 #include <string>
-#include <unordered_set>
+#include <thread>
 #include <vector>
 
 #include "definitions.h"
 #include "persistence.h"
 
+// Below this number of edges, bulk insertions are done serially
+const size_t PARALLEL_EDGE_INSERTION_THRESHOLD = 1 << 16;
+
+void run_in_parallel(const std::function<void(int)>& f) {
+	if (compute_serially()) {
+		for (int t = 0; t < PARALLEL_THREADS; t++) f(t);
+		return;
+	}
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < PARALLEL_THREADS; t++) threads.push_back(std::thread(f, t));
+	for (auto& thread : threads) thread.join();
+}
+
+// Calls write(e, position) for every e < count with keep(e), where position counts the previous such e.
+// Before, allocate is called with the total number of such e.
+template <typename Keep, typename Allocate, typename Write>
+void compact_in_parallel(size_t count, Keep keep, Allocate allocate, Write write) {
+	const size_t per_thread = (count + PARALLEL_THREADS - 1) / PARALLEL_THREADS;
+	std::array<size_t, PARALLEL_THREADS + 1> offsets;
+	offsets.fill(0);
+	run_in_parallel([&](int t) {
+		size_t kept = 0;
+		for (size_t e = t * per_thread; e < std::min(count, (t + 1) * per_thread); e++) kept += keep(e);
+		offsets[t + 1] = kept;
+	});
+	for (int t = 0; t < PARALLEL_THREADS; t++) offsets[t + 1] += offsets[t];
+	allocate(offsets[PARALLEL_THREADS]);
+	run_in_parallel([&](int t) {
+		size_t position = offsets[t];
+		for (size_t e = t * per_thread; e < std::min(count, (t + 1) * per_thread); e++)
+			if (keep(e)) write(e, position++);
+	});
+}
+
 class directed_graph_t {
 public:
 	// The filtration values of the vertices
@@ -59,6 +99,86 @@ public:
     return true;
 	}
 
+	// Adds the given pairs of vertices as edges, this is equivalent to calling add_edge for every pair in order.
+	// The edges are distributed to the threads by their first vertex, so that every thread sets the outgoing
+	// incidences of its own vertices and can detect repeated edges in the order of the input. Returns for every
+	// pair whether it was added.
+	std::vector<uint8_t> add_edges(const vertex_index_t* new_edges, size_t count) {
+		std::vector<uint8_t> added(count, 0);
+		if (count < PARALLEL_EDGE_INSERTION_THRESHOLD) {
+			for (size_t e = 0; e < count; e++) added[e] = add_edge(new_edges[2 * e], new_edges[2 * e + 1]);
+			return added;
+		}
+
+		const auto source = [&](size_t e) {
+			return directed ? new_edges[2 * e] : std::min(new_edges[2 * e], new_edges[2 * e + 1]);
+		};
+		const auto target = [&](size_t e) {
+			return directed ? new_edges[2 * e + 1] : std::max(new_edges[2 * e], new_edges[2 * e + 1]);
+		};
+		const size_t vertices_per_thread = (size_t(number_of_vertices) + PARALLEL_THREADS - 1) / PARALLEL_THREADS;
+		const size_t edges_per_thread = (count + PARALLEL_THREADS - 1) / PARALLEL_THREADS;
+
+		// Sort the edges into buckets by their first vertex, keeping the order of the input inside every bucket
+		std::array<std::array<size_t, PARALLEL_THREADS + 1>, PARALLEL_THREADS> bucket_offsets;
+		run_in_parallel([&](int t) {
+			std::array<size_t, PARALLEL_THREADS + 1> sizes;
+			sizes.fill(0);
+			for (size_t e = t * edges_per_thread; e < std::min(count, (t + 1) * edges_per_thread); e++)
+				sizes[source(e) / vertices_per_thread + 1]++;
+			bucket_offsets[t] = sizes;
+		});
+		size_t offset = 0;
+		for (int bucket = 0; bucket < PARALLEL_THREADS; bucket++) {
+			for (int t = 0; t < PARALLEL_THREADS; t++) {
+				const size_t size = bucket_offsets[t][bucket + 1];
+				bucket_offsets[t][bucket] = offset;
+				offset += size;
+			}
+		}
+		std::vector<size_t> buckets(count);
+		run_in_parallel([&](int t) {
+			auto next = bucket_offsets[t];
+			for (size_t e = t * edges_per_thread; e < std::min(count, (t + 1) * edges_per_thread); e++)
+				buckets[next[source(e) / vertices_per_thread]++] = e;
+		});
+
+		// Every thread owns the outgoing incidences of its vertices, the incoming ones are shared
+		std::array<size_t, PARALLEL_THREADS + 1> bucket_begin;
+		for (int bucket = 0; bucket < PARALLEL_THREADS; bucket++) bucket_begin[bucket] = bucket_offsets[0][bucket];
+		bucket_begin[PARALLEL_THREADS] = count;
+		run_in_parallel([&](int t) {
+			for (size_t i = bucket_begin[t]; i < bucket_begin[t + 1]; i++) {
+				const size_t e = buckets[i];
+				const vertex_index_t v = source(e), w = target(e);
+				const size_t vv = v >> 6;
+				const size_t ww = w >> 6;
+				auto& outgoing = incidence_outgoing[v * incidence_row_length + ww];
+				if (outgoing & (1UL << (w - (ww << 6)))) continue;
+
+				added[e] = 1;
+				outgoing |= 1UL << (w - (ww << 6));
+				outdegrees[v]++;
+				__atomic_fetch_or(&incidence_incoming[w * incidence_row_length + vv], 1UL << (v - (vv << 6)),
+				                  __ATOMIC_RELAXED);
+				__atomic_fetch_add(&indegrees[w], 1, __ATOMIC_RELAXED);
+			}
+		});
+		std::vector<size_t>().swap(buckets);
+
+		// Append the added edges in the order of the input
+		const size_t first_edge = edges.size();
+		compact_in_parallel(
+		    count, [&](size_t e) { return added[e]; },
+		    [&](size_t total) { edges.resize(first_edge + 2 * total); },
+		    [&](size_t e, size_t position) {
+			    edges[first_edge + 2 * position] = source(e);
+			    edges[first_edge + 2 * position + 1] = target(e);
+		    });
+
+		return added;
+	}
+
 	bool is_connected_by_an_edge(vertex_index_t from, vertex_index_t to) const {
 		const auto t = to >> 6;
 		return incidence_outgoing[incidence_row_length * from + t] & (1UL << (to - (t << 6)));
@@ -79,43 +199,63 @@ public:
 	std::vector<value_t> vertex_filtration;
 	std::vector<value_t> edge_filtration;
 
-	filtered_directed_graph_t(const std::vector<value_t> _vertex_filtration, bool directed)
-	    : directed_graph_t(_vertex_filtration.size(), directed), vertex_filtration(_vertex_filtration) {}
-
-	// WARNING: This does not take the filtration into account!
-	// TODO: Think about how to do this efficiently.
-	filtered_directed_graph_t(filtered_directed_graph_t* big_graph, std::unordered_set<vertex_index_t> subset)
-	    : filtered_directed_graph_t(std::vector<value_t>(subset.size(), 0), big_graph->directed) {
-		// Add the edges
-		std::unordered_map<vertex_index_t, vertex_index_t> vertex_indices;
-		vertex_index_t index = 0;
-		for (auto v : subset) vertex_indices.insert(std::make_pair(v, index++));
-
-		for (auto v : subset) {
-			// Check intersections in chunks of 64
-			for (size_t offset = 0; offset < big_graph->incidence_row_length; offset++) {
-				auto bits = big_graph->get_outgoing_chunk(v, offset);
-				size_t vertex_offset = offset << 6;
-
-				while (bits > 0) {
-					// Get the least significant non-zero bit
-					int b = __builtin_ctzl(bits);
-
-					// Unset this bit
-					bits &= ~(1UL << b);
-
-					if (subset.find(vertex_offset + b) != subset.end())
-						add_filtered_edge(vertex_indices[v], vertex_indices[vertex_offset + b], 0);
-				}
-			}
-		}
-	}
+	filtered_directed_graph_t(const std::vector<value_t> _vertex_filtration, bool directed, float density_hint = 0.01)
+	    : directed_graph_t(_vertex_filtration.size(), directed, density_hint), vertex_filtration(_vertex_filtration) {}
 
 	void add_filtered_edge(vertex_index_t v, vertex_index_t w, value_t filtration) {
 		if (directed_graph_t::add_edge(v, w) && filtration != std::numeric_limits<value_t>::lowest())
       edge_filtration.push_back(filtration);
 	}
 
+	// Adds the given pairs of vertices as edges with the given filtration values (if not null), this is
+	// equivalent to calling add_filtered_edge (or add_edge) for every pair in order
+	void add_filtered_edges(const vertex_index_t* new_edges, const value_t* filtration, size_t count) {
+		const auto added = add_edges(new_edges, count);
+		if (filtration == nullptr) return;
+
+		const auto keep = [&](size_t e) { return added[e] && filtration[e] != std::numeric_limits<value_t>::lowest(); };
+		const size_t first_value = edge_filtration.size();
+		compact_in_parallel(
+		    count, keep, [&](size_t total) { edge_filtration.resize(first_value + total); },
+		    [&](size_t e, size_t position) { edge_filtration[first_value + position] = filtration[e]; });
+	}
+
+	// Reorders the edges (and their filtration values) into the order in which the flag complexes enumerate them
+	// with the given number of threads: thread t visits the sources v with v % number_of_threads == t in
+	// increasing order, and the targets of every source in increasing order. This is a counting sort by
+	// target followed by a stable counting sort by source.
+	void sort_edges_in_enumeration_order(int number_of_threads, bool with_filtration) {
+		const size_t number_of_edges = edge_number();
+		std::vector<size_t> offsets(size_t(number_of_vertices) + 1, 0);
+		for (size_t e = 0; e < number_of_edges; e++) offsets[edges[2 * e + 1] + 1]++;
+		for (vertex_index_t v = 0; v < number_of_vertices; v++) offsets[v + 1] += offsets[v];
+		std::vector<size_t> by_target(number_of_edges);
+		for (size_t e = 0; e < number_of_edges; e++) by_target[offsets[edges[2 * e + 1]]++] = e;
+
+		// The sources get their positions in the order of the threads
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (size_t e = 0; e < number_of_edges; e++) offsets[edges[2 * e]]++;
+		size_t position = 0;
+		for (int t = 0; t < number_of_threads; t++) {
+			for (size_t v = t; v < number_of_vertices; v += number_of_threads) {
+				const size_t size = offsets[v];
+				offsets[v] = position;
+				position += size;
+			}
+		}
+
+		std::vector<vertex_index_t> new_edges(edges.size());
+		std::vector<value_t> new_filtration(with_filtration ? number_of_edges : 0);
+		for (auto e : by_target) {
+			const size_t p = offsets[edges[2 * e]]++;
+			new_edges[2 * p] = edges[2 * e];
+			new_edges[2 * p + 1] = edges[2 * e + 1];
+			if (with_filtration) new_filtration[p] = edge_filtration[e];
+		}
+		edges.swap(new_edges);
+		if (with_filtration) edge_filtration.swap(new_filtration);
+	}
+
 	std::vector<filtered_directed_graph_t> get_connected_subgraphs(vertex_index_t minimal_number_of_vertices) {
 #ifdef INDICATE_PROGRESS
 		std::cout << "\033[K"
@@ -131,23 +271,74 @@ public:
 			if (u != v) dset.link(u, v);
 		}
 
-		std::vector<filtered_directed_graph_t> subgraphs;
-		{
-			std::unordered_map<vertex_index_t, std::unordered_set<vertex_index_t>> connected_components;
-			for (vertex_index_t index = 0; index < number_of_vertices; ++index) {
-				vertex_index_t component = dset.find(index);
-				if (connected_components.find(component) == connected_components.end()) {
-					connected_components.insert(std::make_pair(component, std::unordered_set<vertex_index_t>()));
-				}
-
-				connected_components[component].insert(index);
+		// Number the components in the order of their smallest vertex, every vertex gets the next free index
+		// in its component
+		const vertex_index_t no_component = std::numeric_limits<vertex_index_t>::max();
+		std::vector<vertex_index_t> component_of_root(number_of_vertices, no_component);
+		std::vector<vertex_index_t> component(number_of_vertices);
+		std::vector<vertex_index_t> local_index(number_of_vertices);
+		std::vector<vertex_index_t> component_size;
+		for (vertex_index_t v = 0; v < number_of_vertices; v++) {
+			auto& c = component_of_root[dset.find(v)];
+			if (c == no_component) {
+				c = vertex_index_t(component_size.size());
+				component_size.push_back(0);
 			}
+			component[v] = c;
+			local_index[v] = component_size[c]++;
+		}
+		std::vector<vertex_index_t>().swap(component_of_root);
 
-			for (auto pair : connected_components) {
-				auto vertex_set = pair.second;
-				if (vertex_set.size() < minimal_number_of_vertices) continue;
-				subgraphs.push_back(filtered_directed_graph_t(this, vertex_set));
-			}
+		// Only the large enough components become subgraphs
+		std::vector<vertex_index_t> subgraph_of_component(component_size.size(), no_component);
+		std::vector<std::vector<value_t>> subgraph_vertex_filtration;
+		for (size_t c = 0; c < component_size.size(); c++) {
+			if (component_size[c] < minimal_number_of_vertices) continue;
+			subgraph_of_component[c] = vertex_index_t(subgraph_vertex_filtration.size());
+			subgraph_vertex_filtration.push_back(std::vector<value_t>(component_size[c]));
+		}
+		for (vertex_index_t v = 0; v < number_of_vertices; v++) {
+			const auto subgraph = subgraph_of_component[component[v]];
+			if (subgraph != no_component) subgraph_vertex_filtration[subgraph][local_index[v]] = vertex_filtration[v];
+		}
+
+		// Distribute the edges (and their filtration values) to the subgraphs, keeping their order
+		const bool with_edge_filtration = edge_filtration.size() == number_of_edges;
+		const size_t number_of_subgraphs = subgraph_vertex_filtration.size();
+		std::vector<size_t> subgraph_edge_number(number_of_subgraphs, 0);
+		for (size_t e = 0; e < number_of_edges; e++) {
+			const auto subgraph = subgraph_of_component[component[edges[2 * e]]];
+			if (subgraph != no_component) subgraph_edge_number[subgraph]++;
+		}
+		std::vector<std::vector<vertex_index_t>> subgraph_edges(number_of_subgraphs);
+		std::vector<std::vector<value_t>> subgraph_edge_filtration(number_of_subgraphs);
+		for (size_t subgraph = 0; subgraph < number_of_subgraphs; subgraph++) {
+			subgraph_edges[subgraph].reserve(2 * subgraph_edge_number[subgraph]);
+			if (with_edge_filtration) subgraph_edge_filtration[subgraph].reserve(subgraph_edge_number[subgraph]);
+		}
+		for (size_t e = 0; e < number_of_edges; e++) {
+			const vertex_index_t v = edges[2 * e], w = edges[2 * e + 1];
+			const auto subgraph = subgraph_of_component[component[v]];
+			if (subgraph == no_component) continue;
+			subgraph_edges[subgraph].push_back(local_index[v]);
+			subgraph_edges[subgraph].push_back(local_index[w]);
+			if (with_edge_filtration) subgraph_edge_filtration[subgraph].push_back(edge_filtration[e]);
+		}
+		std::vector<vertex_index_t>().swap(component);
+		std::vector<vertex_index_t>().swap(local_index);
+
+		std::vector<filtered_directed_graph_t> subgraphs;
+		subgraphs.reserve(number_of_subgraphs);
+		for (size_t subgraph = 0; subgraph < number_of_subgraphs; subgraph++) {
+			// The number of edges is known, so there is no need to guess it from the density
+			subgraphs.push_back(filtered_directed_graph_t(subgraph_vertex_filtration[subgraph], directed, 0));
+			subgraphs.back().edges.reserve(2 * subgraph_edge_number[subgraph]);
+			subgraphs.back().add_filtered_edges(subgraph_edges[subgraph].data(),
+			                                    with_edge_filtration ? subgraph_edge_filtration[subgraph].data() : nullptr,
+			                                    subgraph_edge_number[subgraph]);
+			std::vector<value_t>().swap(subgraph_vertex_filtration[subgraph]);
+			std::vector<vertex_index_t>().swap(subgraph_edges[subgraph]);
+			std::vector<value_t>().swap(subgraph_edge_filtration[subgraph]);
 		}
 
 		return subgraphs;
@@ -1,22 +1,190 @@
 #pragma once
 
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
 #include <fstream>
+#include <initializer_list>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "../argparser.h"
 #include "../definitions.h"
 #include "../directed_graph.h"
 
+// An invalid input file, this is only thrown if input_errors_are_thrown() is set in the reading thread
+class input_error_t : public std::runtime_error {
+public:
+	input_error_t(const std::string& message) : std::runtime_error(message) {}
+};
+
+// Set in threads that read many graphs (flagser's batch mode), an invalid graph then only fails itself
+inline bool& input_errors_are_thrown() {
+	static thread_local bool thrown = false;
+	return thrown;
+}
+
+// Reports an invalid input file, the parts of the message are written one after the other
+template <typename... Parts> [[noreturn]] void input_error(const Parts&... parts) {
+	std::ostringstream message;
+	(void)std::initializer_list<int>{(message << parts, 0)...};
+	if (input_errors_are_thrown()) throw input_error_t(message.str());
+	std::cerr << message.str() << std::endl;
+	exit(-1);
+}
+
 void open_file(const std::string filename, std::ifstream& file_stream) {
 	file_stream.open(filename);
-	if (file_stream.fail()) {
-		std::cerr << "couldn't open file " << filename << std::endl;
-		exit(-1);
-	}
+	if (file_stream.fail()) input_error("couldn't open file ", filename);
 }
 
 inline std::string trim(const std::string& s) {
 	auto wsfront = std::find_if_not(s.begin(), s.end(), [](int c) { return std::isspace(c); });
 	auto wsback = std::find_if_not(s.rbegin(), s.rend(), [](int c) { return std::isspace(c); }).base();
 	return (wsback <= wsfront ? std::string() : std::string(wsfront, wsback));
-}
\ No newline at end of file
+}
+
+// A read-only memory mapping of a whole file
+class mapped_file_t {
+	int file_descriptor = -1;
+	const char* data = nullptr;
+	size_t length = 0;
+
+public:
+	mapped_file_t(const std::string filename) {
+		file_descriptor = open(filename.c_str(), O_RDONLY);
+		struct stat status;
+		if (file_descriptor < 0 || fstat(file_descriptor, &status) != 0) {
+			if (file_descriptor >= 0) close(file_descriptor);
+			input_error("couldn't open file ", filename);
+		}
+
+		length = status.st_size;
+		if (length == 0) return;
+		void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+		if (address == MAP_FAILED) {
+			close(file_descriptor);
+			input_error("couldn't map file ", filename, " into memory");
+		}
+		data = static_cast<const char*>(address);
+	}
+	mapped_file_t(const mapped_file_t&) = delete;
+	mapped_file_t& operator=(const mapped_file_t&) = delete;
+
+	~mapped_file_t() {
+		if (data != nullptr) munmap(const_cast<char*>(data), length);
+		if (file_descriptor >= 0) close(file_descriptor);
+	}
+
+	const char* begin() const { return data; }
+	const char* end() const { return data + length; }
+	size_t size() const { return length; }
+};
+
+// The input file name that stands for the standard input
+const std::string STANDARD_INPUT_FILENAME = "-";
+
+// Reads a file descriptor (e.g. a pipe) sequentially in large blocks
+class input_stream_t {
+	int file_descriptor;
+	std::vector<char> buffer;
+	size_t data_begin = 0;
+	size_t data_end = 0;
+	bool finished = false;
+
+	// Moves the unconsumed data to the front and reads until the buffer is full or the input ends
+	void fill() {
+		if (data_begin > 0) {
+			memmove(buffer.data(), buffer.data() + data_begin, data_end - data_begin);
+			data_end -= data_begin;
+			data_begin = 0;
+		}
+		if (data_end == buffer.size()) buffer.resize(2 * buffer.size());
+
+		while (!finished && data_end < buffer.size()) {
+			const ssize_t length = read(file_descriptor, buffer.data() + data_end, buffer.size() - data_end);
+			if (length < 0 && errno == EINTR) continue;
+			if (length < 0) input_error("couldn't read from the input stream");
+			finished = length == 0;
+			data_end += length;
+		}
+	}
+
+public:
+	input_stream_t(int _file_descriptor, size_t block_size = 1 << 24)
+	    : file_descriptor(_file_descriptor), buffer(block_size) {}
+
+	// Returns the next block of complete lines, the last line of the input does not need to end with a newline.
+	// The block stays valid until the next call, returns false at the end of the input.
+	bool next_lines(const char*& first, const char*& last) {
+		while (true) {
+			const char* begin = buffer.data() + data_begin;
+			const char* newline = static_cast<const char*>(memrchr(begin, '\n', data_end - data_begin));
+			if (newline != nullptr || (finished && data_begin < data_end)) {
+				first = begin;
+				last = newline != nullptr ? newline + 1 : buffer.data() + data_end;
+				data_begin = last - buffer.data();
+				return true;
+			}
+			if (finished) return false;
+			fill();
+		}
+	}
+
+	// Skips exactly count bytes
+	void skip_bytes(size_t count) {
+		char discarded[4096];
+		for (size_t length; count > 0; count -= length) {
+			length = std::min(count, sizeof(discarded));
+			read_bytes(discarded, length);
+		}
+	}
+
+	// Reads exactly count bytes into the destination
+	void read_bytes(char* destination, size_t count) {
+		while (count > 0) {
+			if (data_begin == data_end) {
+				if (finished) input_error("The input stream ended unexpectedly.");
+				fill();
+				continue;
+			}
+			const size_t length = std::min(count, data_end - data_begin);
+			memcpy(destination, buffer.data() + data_begin, length);
+			data_begin += length;
+			destination += length;
+			count -= length;
+		}
+	}
+};
+
+// Collects edges and adds them to the graph in bulk, so that they are inserted in parallel. The remaining
+// edges are only added by calling flush.
+class graph_edge_buffer_t {
+	filtered_directed_graph_t& graph;
+	bool with_filtration;
+	std::vector<vertex_index_t> edges;
+	std::vector<value_t> filtration;
+
+public:
+	static const size_t capacity = 1 << 22;
+
+	graph_edge_buffer_t(filtered_directed_graph_t& _graph, bool _with_filtration)
+	    : graph(_graph), with_filtration(_with_filtration) {}
+
+	inline void add(vertex_index_t v, vertex_index_t w, value_t value = 0) {
+		edges.push_back(v);
+		edges.push_back(w);
+		if (with_filtration) filtration.push_back(value);
+		if (edges.size() >= 2 * capacity) flush();
+	}
+
+	void flush() {
+		graph.add_filtered_edges(edges.data(), with_filtration ? filtration.data() : nullptr, edges.size() / 2);
+		edges.clear();
+		filtration.clear();
+	}
+};
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+#include "base.h"
+
+// Binary graph format. All numbers are little-endian and every section starts at a multiple of 64 bytes.
+//
+//   header (64 bytes):
+//     char[8]  "FLAGSERG"
+//     uint32   format version (1)
+//     uint32   flags, bit 0 is set if the file contains edge filtration values
+//     uint64   number of vertices n
+//     uint64   number of edges m
+//     uint64   offset of the vertex filtration (n float32)
+//     uint64   offset of the row offsets (n + 1 uint64), the edges starting at the vertex v are the
+//              edges row_offsets[v], ..., row_offsets[v + 1] - 1
+//     uint64   offset of the targets of the edges (m uint32)
+//     uint64   offset of the edge filtration (m float32), 0 if there is none
+
+const char BINARY_GRAPH_MAGIC[8] = {'F', 'L', 'A', 'G', 'S', 'E', 'R', 'G'};
+const uint32_t BINARY_GRAPH_VERSION = 1;
+const uint32_t BINARY_GRAPH_HAS_EDGE_FILTRATION = 1;
+const size_t BINARY_GRAPH_HEADER_SIZE = 64;
+const size_t BINARY_GRAPH_ALIGNMENT = 64;
+
+struct binary_graph_header_t {
+	uint32_t version;
+	uint32_t flags;
+	uint64_t number_of_vertices;
+	uint64_t number_of_edges;
+	uint64_t vertex_filtration_offset;
+	uint64_t row_offsets_offset;
+	uint64_t targets_offset;
+	uint64_t edge_filtration_offset;
+
+	bool has_edge_filtration() const { return flags & BINARY_GRAPH_HAS_EDGE_FILTRATION; }
+};
+
+inline bool is_little_endian() {
+	const uint16_t one = 1;
+	return *reinterpret_cast<const uint8_t*>(&one) == 1;
+}
+
+template <typename T> inline T read_little_endian(const char* p) {
+	char bytes[sizeof(T)];
+	memcpy(bytes, p, sizeof(T));
+	if (!is_little_endian()) std::reverse(bytes, bytes + sizeof(T));
+	T value;
+	memcpy(&value, bytes, sizeof(T));
+	return value;
+}
+
+template <typename T> inline void write_little_endian(std::ostream& stream, T value) {
+	char bytes[sizeof(T)];
+	memcpy(bytes, &value, sizeof(T));
+	if (!is_little_endian()) std::reverse(bytes, bytes + sizeof(T));
+	stream.write(bytes, sizeof(T));
+}
+
+inline uint64_t align_binary_graph_offset(uint64_t offset) {
+	return (offset + BINARY_GRAPH_ALIGNMENT - 1) / BINARY_GRAPH_ALIGNMENT * BINARY_GRAPH_ALIGNMENT;
+}
+
+binary_graph_header_t compute_binary_graph_layout(uint64_t number_of_vertices, uint64_t number_of_edges,
+                                                  bool with_edge_filtration) {
+	static_assert(sizeof(value_t) == 4 && sizeof(vertex_index_t) == 4, "The binary format stores 32-bit values");
+
+	binary_graph_header_t header;
+	header.version = BINARY_GRAPH_VERSION;
+	header.flags = with_edge_filtration ? BINARY_GRAPH_HAS_EDGE_FILTRATION : 0;
+	header.number_of_vertices = number_of_vertices;
+	header.number_of_edges = number_of_edges;
+	header.vertex_filtration_offset = BINARY_GRAPH_HEADER_SIZE;
+	header.row_offsets_offset =
+	    align_binary_graph_offset(header.vertex_filtration_offset + sizeof(value_t) * number_of_vertices);
+	header.targets_offset =
+	    align_binary_graph_offset(header.row_offsets_offset + sizeof(uint64_t) * (number_of_vertices + 1));
+	header.edge_filtration_offset =
+	    with_edge_filtration
+	        ? align_binary_graph_offset(header.targets_offset + sizeof(vertex_index_t) * number_of_edges)
+	        : 0;
+	return header;
+}
+
+binary_graph_header_t read_binary_graph_header(const char* data, size_t size, const std::string& filename) {
+	if (size < BINARY_GRAPH_HEADER_SIZE || memcmp(data, BINARY_GRAPH_MAGIC, sizeof(BINARY_GRAPH_MAGIC)) != 0)
+		input_error("The file \"", filename, "\" is not a binary graph file.");
+
+	binary_graph_header_t header;
+	header.version = read_little_endian<uint32_t>(data + 8);
+	header.flags = read_little_endian<uint32_t>(data + 12);
+	header.number_of_vertices = read_little_endian<uint64_t>(data + 16);
+	header.number_of_edges = read_little_endian<uint64_t>(data + 24);
+	header.vertex_filtration_offset = read_little_endian<uint64_t>(data + 32);
+	header.row_offsets_offset = read_little_endian<uint64_t>(data + 40);
+	header.targets_offset = read_little_endian<uint64_t>(data + 48);
+	header.edge_filtration_offset = read_little_endian<uint64_t>(data + 56);
+
+	if (header.version != BINARY_GRAPH_VERSION) {
+		input_error("The binary graph file \"", filename, "\" has version ", header.version, ", but only version ",
+		            BINARY_GRAPH_VERSION, " is supported.");
+	}
+
+	if (header.number_of_vertices > uint64_t(std::numeric_limits<vertex_index_t>::max())) {
+		input_error("The binary graph file \"", filename, "\" has ", header.number_of_vertices,
+		            " vertices, but at most ", std::numeric_limits<vertex_index_t>::max(), " are supported.");
+	}
+
+	// Every section has to be inside of the file
+	const auto section_fits = [size](uint64_t offset, uint64_t count, uint64_t element_size) {
+		return offset <= size && count <= (size - offset) / element_size;
+	};
+	if (!section_fits(header.vertex_filtration_offset, header.number_of_vertices, sizeof(value_t)) ||
+	    !section_fits(header.row_offsets_offset, header.number_of_vertices + 1, sizeof(uint64_t)) ||
+	    !section_fits(header.targets_offset, header.number_of_edges, sizeof(vertex_index_t)) ||
+	    (header.has_edge_filtration() &&
+	     !section_fits(header.edge_filtration_offset, header.number_of_edges, sizeof(value_t))))
+		input_error("The binary graph file \"", filename, "\" is truncated.");
+
+	return header;
+}
+
+// Builds the graph from the sections of a binary graph file
+filtered_directed_graph_t build_binary_graph(const binary_graph_header_t& header, const char* vertex_filtration_data,
+                                             const char* row_offsets, const char* targets, const char* edge_filtration,
+                                             const std::string& filename, bool directed) {
+	std::vector<value_t> vertex_filtration(header.number_of_vertices);
+	if (is_little_endian()) {
+		memcpy(vertex_filtration.data(), vertex_filtration_data, sizeof(value_t) * header.number_of_vertices);
+	} else {
+		for (size_t v = 0; v < header.number_of_vertices; v++)
+			vertex_filtration[v] = read_little_endian<value_t>(vertex_filtration_data + sizeof(value_t) * v);
+	}
+
+	// The row offsets are checked first, then the edges are copied in parallel
+	std::vector<uint64_t> first_edges(header.number_of_vertices + 1);
+	for (size_t v = 0; v <= header.number_of_vertices; v++) {
+		first_edges[v] = read_little_endian<uint64_t>(row_offsets + sizeof(uint64_t) * v);
+		if ((v > 0 && first_edges[v] < first_edges[v - 1]) || first_edges[v] > header.number_of_edges)
+			input_error("The binary graph file \"", filename, "\" contains invalid row offsets.");
+	}
+
+	const uint64_t first_edge = first_edges[0];
+	const uint64_t number_of_edges = first_edges[header.number_of_vertices] - first_edge;
+	std::vector<vertex_index_t> edges(2 * number_of_edges);
+	std::vector<value_t> filtration(header.has_edge_filtration() ? number_of_edges : 0);
+	const size_t vertices_per_thread = (header.number_of_vertices + PARALLEL_THREADS - 1) / PARALLEL_THREADS;
+	// The threads stop at the first invalid edge, the error is reported after all of them are done
+	std::array<std::string, PARALLEL_THREADS> errors;
+	run_in_parallel([&](int t) {
+		const uint64_t last_vertex = std::min(header.number_of_vertices, uint64_t((t + 1) * vertices_per_thread));
+		for (uint64_t v = t * vertices_per_thread; v < last_vertex; v++) {
+			for (uint64_t e = first_edges[v]; e < first_edges[v + 1]; e++) {
+				const auto w = read_little_endian<vertex_index_t>(targets + sizeof(vertex_index_t) * e);
+				if (w >= header.number_of_vertices) {
+					errors[t] = "The binary graph file \"" + filename + "\" contains the edge (" + std::to_string(v) +
+					            ", " + std::to_string(w) + "), but there are only " +
+					            std::to_string(header.number_of_vertices) + " vertices.";
+					return;
+				}
+
+				edges[2 * (e - first_edge)] = vertex_index_t(v);
+				edges[2 * (e - first_edge) + 1] = w;
+				if (header.has_edge_filtration()) {
+					const value_t value = read_little_endian<value_t>(edge_filtration + sizeof(value_t) * e);
+					if (value < std::max(vertex_filtration[v], vertex_filtration[w])) {
+						std::ostringstream error;
+						error << "The binary graph file \"" << filename << "\" contains an edge filtration that "
+						      << "contradicts the vertex filtration, the edge (" << v << ", " << w
+						      << ") has filtration value " << value << ", which is lower than max("
+						      << vertex_filtration[v] << ", " << vertex_filtration[w]
+						      << "), the filtrations of its vertices.";
+						errors[t] = error.str();
+						return;
+					}
+					filtration[e - first_edge] = value;
+				}
+			}
+		}
+	});
+	for (const auto& error : errors)
+		if (!error.empty()) input_error(error);
+
+	filtered_directed_graph_t graph(vertex_filtration, directed);
+	graph.add_filtered_edges(edges.data(), header.has_edge_filtration() ? filtration.data() : nullptr, number_of_edges);
+
+	return graph;
+}
+
+// Reads a binary graph file from the standard input in a single pass, this needs the sections to be stored in
+// the order of the header (as written by write_graph_binary)
+filtered_directed_graph_t read_graph_binary_from_stream(input_stream_t& stream, bool directed) {
+	const std::string filename = "<standard input>";
+	char header_data[BINARY_GRAPH_HEADER_SIZE];
+	stream.read_bytes(header_data, BINARY_GRAPH_HEADER_SIZE);
+	const binary_graph_header_t header =
+	    read_binary_graph_header(header_data, std::numeric_limits<size_t>::max(), filename);
+
+	uint64_t position = BINARY_GRAPH_HEADER_SIZE;
+	const auto read_section = [&](uint64_t offset, uint64_t size, std::vector<char>& section) {
+		if (offset < position) {
+			input_error("The sections of the binary graph file are not stored in order, so it can not be read from "
+			            "the standard input.");
+		}
+		stream.skip_bytes(offset - position);
+		section.resize(size);
+		stream.read_bytes(section.data(), size);
+		position = offset + size;
+	};
+
+	std::vector<char> vertex_filtration, row_offsets, targets, edge_filtration;
+	read_section(header.vertex_filtration_offset, sizeof(value_t) * header.number_of_vertices, vertex_filtration);
+	read_section(header.row_offsets_offset, sizeof(uint64_t) * (header.number_of_vertices + 1), row_offsets);
+	read_section(header.targets_offset, sizeof(vertex_index_t) * header.number_of_edges, targets);
+	if (header.has_edge_filtration())
+		read_section(header.edge_filtration_offset, sizeof(value_t) * header.number_of_edges, edge_filtration);
+
+	return build_binary_graph(header, vertex_filtration.data(), row_offsets.data(), targets.data(),
+	                          edge_filtration.data(), filename, directed);
+}
+
+filtered_directed_graph_t read_graph_binary(const std::string filename, const named_arguments_t& named_arguments) {
+	bool directed = std::string(get_argument_or_default(named_arguments, "undirected", "directed")) != "true";
+
+	if (filename == STANDARD_INPUT_FILENAME) {
+		input_stream_t stream(STDIN_FILENO);
+		return read_graph_binary_from_stream(stream, directed);
+	}
+
+	mapped_file_t file(filename);
+	const binary_graph_header_t header = read_binary_graph_header(file.begin(), file.size(), filename);
+	return build_binary_graph(header, file.begin() + header.vertex_filtration_offset,
+	                          file.begin() + header.row_offsets_offset, file.begin() + header.targets_offset,
+	                          file.begin() + header.edge_filtration_offset, filename, directed);
+}
+
+// Writes the graph in the binary format, the edges are sorted by their first vertex
+void write_graph_binary(const filtered_directed_graph_t& graph, std::ostream& stream) {
+	const uint64_t number_of_vertices = graph.vertex_number();
+	const uint64_t number_of_edges = graph.edge_number();
+	const bool with_edge_filtration = number_of_edges > 0 && graph.edge_filtration.size() == number_of_edges;
+	const binary_graph_header_t header =
+	    compute_binary_graph_layout(number_of_vertices, number_of_edges, with_edge_filtration);
+
+	// Counting sort of the edges by their first vertex
+	std::vector<uint64_t> row_offsets(number_of_vertices + 1, 0);
+	for (uint64_t e = 0; e < number_of_edges; e++) row_offsets[graph.edges[2 * e] + 1]++;
+	for (uint64_t v = 0; v < number_of_vertices; v++) row_offsets[v + 1] += row_offsets[v];
+	std::vector<uint64_t> next_edge(row_offsets.begin(), row_offsets.end() - 1);
+	std::vector<vertex_index_t> targets(number_of_edges);
+	std::vector<value_t> edge_filtration(with_edge_filtration ? number_of_edges : 0);
+	for (uint64_t e = 0; e < number_of_edges; e++) {
+		const uint64_t position = next_edge[graph.edges[2 * e]]++;
+		targets[position] = graph.edges[2 * e + 1];
+		if (with_edge_filtration) edge_filtration[position] = graph.edge_filtration[e];
+	}
+
+	uint64_t position = 0;
+	const auto pad_to = [&stream, &position](uint64_t offset) {
+		for (; position < offset; position++) stream.put('\0');
+	};
+
+	stream.write(BINARY_GRAPH_MAGIC, sizeof(BINARY_GRAPH_MAGIC));
+	write_little_endian(stream, header.version);
+	write_little_endian(stream, header.flags);
+	write_little_endian(stream, header.number_of_vertices);
+	write_little_endian(stream, header.number_of_edges);
+	write_little_endian(stream, header.vertex_filtration_offset);
+	write_little_endian(stream, header.row_offsets_offset);
+	write_little_endian(stream, header.targets_offset);
+	write_little_endian(stream, header.edge_filtration_offset);
+	position = BINARY_GRAPH_HEADER_SIZE;
+
+	pad_to(header.vertex_filtration_offset);
+	for (auto f : graph.vertex_filtration) write_little_endian(stream, f);
+	position += sizeof(value_t) * number_of_vertices;
+
+	pad_to(header.row_offsets_offset);
+	for (auto offset : row_offsets) write_little_endian(stream, offset);
+	position += sizeof(uint64_t) * row_offsets.size();
+
+	pad_to(header.targets_offset);
+	for (auto w : targets) write_little_endian(stream, w);
+	position += sizeof(vertex_index_t) * number_of_edges;
+
+	if (with_edge_filtration) {
+		pad_to(header.edge_filtration_offset);
+		for (auto f : edge_filtration) write_little_endian(stream, f);
+	}
+}
@@ -1,6 +1,12 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <functional>
+#include <iomanip>
+#include <limits>
+#include <thread>
 
 #include "base.h"
 
@@ -16,59 +22,267 @@ std::vector<t> split(const std::string& s, char delim, const std::function<t(std
 	return elems;
 }
 
-enum HAS_EDGE_FILTRATION { TOO_EARLY_TO_DECIDE, MAYBE, YES, NO };
-filtered_directed_graph_t read_graph_flagser(const std::string filename, const named_arguments_t& named_arguments) {
-	std::string line;
-	filtered_directed_graph_t* graph;
-	int current_dimension = 0;
-	std::vector<value_t> vertex_filtration;
-	HAS_EDGE_FILTRATION has_edge_filtration = HAS_EDGE_FILTRATION::TOO_EARLY_TO_DECIDE;
-	bool directed = std::string(get_argument_or_default(named_arguments, "undirected", "directed")) != "true";
+// The .flag files are parsed in place in the memory mapped file. A position is always a pointer into the
+// file together with the end of the file, nothing is copied except for unusual floating point numbers.
+inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+inline const char* skip_blanks(const char* p, const char* end) {
+	while (p != end && is_blank(*p)) p++;
+	return p;
+}
+
+inline const char* end_of_line(const char* p, const char* end) {
+	const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+	return newline == nullptr ? end : newline;
+}
+
+inline const char* end_of_token(const char* p, const char* end) {
+	while (p != end && !is_blank(*p)) p++;
+	return p;
+}
 
-	std::ifstream input_stream;
-	open_file(filename, input_stream);
-
-	while (not input_stream.eof()) {
-		getline(input_stream, line);
-		line = trim(line);
-		if (line.length() == 0) continue;
-		if (line[0] == 'd' && line[1] == 'i' && line[2] == 'm') {
-			if (line[4] == '1') {
-				graph = new filtered_directed_graph_t(vertex_filtration, directed);
-				current_dimension = 1;
-				has_edge_filtration = HAS_EDGE_FILTRATION::MAYBE;
+inline bool parse_vertex(const char*& p, const char* end, vertex_index_t& vertex) {
+	p = skip_blanks(p, end);
+	if (p == end || *p < '0' || *p > '9') return false;
+	uint64_t value = 0;
+	while (p != end && *p >= '0' && *p <= '9') value = 10 * value + (*p++ - '0');
+	vertex = vertex_index_t(value);
+	// Like atoi, ignore anything after the digits (e.g. "3.0")
+	p = end_of_token(p, end);
+	return true;
+}
+
+// Decimal numbers with at most 19 significant digits and a small exponent are computed with a single
+// (correctly rounded) floating point operation, which gives the same result as atof. Everything else
+// (long mantissas, inf, nan, ...) is passed to atof.
+inline bool parse_value(const char*& p, const char* end, value_t& value) {
+	static const double powers_of_ten[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	                                       1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+	p = skip_blanks(p, end);
+	const char* token_end = end_of_token(p, end);
+	if (p == token_end) return false;
+
+	const char* q = p;
+	bool negative = false;
+	if (*q == '-' || *q == '+') negative = *q++ == '-';
+
+	uint64_t mantissa = 0;
+	int digits = 0, exponent = 0;
+	bool has_digits = false;
+	for (; q != token_end && *q >= '0' && *q <= '9'; q++, has_digits = true) {
+		if (digits < 19) {
+			mantissa = 10 * mantissa + (*q - '0');
+			if (mantissa > 0) digits++;
+		} else
+			exponent++;
+	}
+	if (q != token_end && *q == '.') {
+		for (q++; q != token_end && *q >= '0' && *q <= '9'; q++, has_digits = true) {
+			if (digits < 19) {
+				mantissa = 10 * mantissa + (*q - '0');
+				if (mantissa > 0) digits++;
+				exponent--;
 			}
-			continue;
 		}
+	}
+	if (has_digits && q != token_end && (*q == 'e' || *q == 'E')) {
+		const char* r = q + 1;
+		bool negative_exponent = false;
+		if (r != token_end && (*r == '-' || *r == '+')) negative_exponent = *r++ == '-';
+		int e = 0;
+		if (r != token_end && *r >= '0' && *r <= '9') {
+			for (; r != token_end && *r >= '0' && *r <= '9'; r++) e = std::min(10 * e + (*r - '0'), 100000);
+			exponent += negative_exponent ? -e : e;
+			q = r;
+		}
+	}
 
-		if (current_dimension == 0) {
-			if (vertex_filtration.empty()) vertex_filtration = split<value_t>(line, ' ', string_to_float);
-		} else {
-			if (has_edge_filtration == HAS_EDGE_FILTRATION::MAYBE) {
-				// If the edge has three components, then there are also filtration values, which we assume to come last
-				int number_of_spaces = 0;
-				for (auto& iter : line)
-					if (iter == ' ') { number_of_spaces++; }
-				has_edge_filtration = number_of_spaces == 1 ? HAS_EDGE_FILTRATION::NO : HAS_EDGE_FILTRATION::YES;
-			}
+	if (has_digits && q == token_end && mantissa < (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+		double result = double(mantissa);
+		result = exponent < 0 ? result / powers_of_ten[-exponent] : result * powers_of_ten[exponent];
+		value = value_t(negative ? -result : result);
+	} else {
+		char buffer[128];
+		const size_t length = std::min(size_t(token_end - p), sizeof(buffer) - 1);
+		std::copy(p, p + length, buffer);
+		buffer[length] = '\0';
+		value = value_t(atof(buffer));
+	}
+
+	p = token_end;
+	return true;
+}
 
-			if (has_edge_filtration == NO) {
-				std::vector<vertex_index_t> vertices = split<vertex_index_t>(line, ' ', string_to_uint);
-				graph->add_edge(vertices[0], vertices[1]);
-			} else {
-				std::vector<value_t> vertices = split<value_t>(line, ' ', string_to_float);
-				if (vertices[2] < std::max(vertex_filtration[vertices[0]], vertex_filtration[vertices[1]])) {
-					std::cerr << "The flagser file contained an edge filtration that contradicts the vertex "
-					             "filtration, the edge ("
-					          << vertices[0] << ", " << vertices[1] << ") has filtration value " << vertices[2]
-					          << ", which is lower than min(" << vertex_filtration[vertices[0]] << ", "
-					          << vertex_filtration[vertices[1]] << "), the filtrations of its vertices.";
-					exit(-1);
-				}
-				graph->add_filtered_edge((vertex_index_t)vertices[0], (vertex_index_t)vertices[1], vertices[2]);
+inline size_t number_of_tokens(const char* p, const char* end) {
+	size_t tokens = 0;
+	while ((p = skip_blanks(p, end)) != end) {
+		p = end_of_token(p, end);
+		tokens++;
+	}
+	return tokens;
+}
+
+inline bool is_dimension_line(const char* p, const char* end) {
+	p = skip_blanks(p, end);
+	return end - p >= 3 && p[0] == 'd' && p[1] == 'i' && p[2] == 'm';
+}
+
+struct flag_edges_t {
+	std::vector<vertex_index_t> edges;
+	std::vector<value_t> filtration;
+	// The first invalid line, this is reported after all chunks are parsed
+	std::string error;
+};
+
+void parse_flag_edges(const char* p, const char* end, bool with_filtration, const std::vector<value_t>& vertex_filtration,
+                      flag_edges_t& result) {
+	for (const char* line_end; p < end; p = line_end + 1) {
+		line_end = end_of_line(p, end);
+		if (skip_blanks(p, line_end) == line_end || is_dimension_line(p, line_end)) continue;
+
+		const char* line = p;
+		vertex_index_t v, w;
+		value_t filtration = 0;
+		if (!parse_vertex(p, line_end, v) || !parse_vertex(p, line_end, w) ||
+		    (with_filtration && !parse_value(p, line_end, filtration))) {
+			result.error =
+			    "The flagser file contains a line that is not an edge: \"" + std::string(line, line_end) + "\"";
+			return;
+		}
+		if (size_t(v) >= vertex_filtration.size() || size_t(w) >= vertex_filtration.size()) {
+			std::ostringstream error;
+			error << "The flagser file contains the edge (" << v << ", " << w << "), but there are only "
+			      << vertex_filtration.size() << " vertices.";
+			result.error = error.str();
+			return;
+		}
+
+		if (with_filtration) {
+			if (filtration < std::max(vertex_filtration[v], vertex_filtration[w])) {
+				std::ostringstream error;
+				error << "The flagser file contained an edge filtration that contradicts the vertex filtration, the "
+				         "edge ("
+				      << v << ", " << w << ") has filtration value " << filtration << ", which is lower than min("
+				      << vertex_filtration[v] << ", " << vertex_filtration[w] << "), the filtrations of its vertices.";
+				result.error = error.str();
+				return;
 			}
+			result.filtration.push_back(filtration);
 		}
+		result.edges.push_back(v);
+		result.edges.push_back(w);
 	}
+}
+
+// Reads the lines of the header in [p, end) (the vertex filtration is the first line before "dim 1") and
+// returns the position after the "dim 1" line, or end if it was not found
+const char* read_flag_header(const char* p, const char* end, std::vector<value_t>& vertex_filtration,
+                             bool& found_edges) {
+	for (const char* line_end; p < end && !found_edges; p = line_end + 1) {
+		line_end = end_of_line(p, end);
+		if (skip_blanks(p, line_end) == line_end) continue;
 
-	return *graph;
-}
\ No newline at end of file
+		if (is_dimension_line(p, line_end)) {
+			const char* q = skip_blanks(skip_blanks(p, line_end) + 3, line_end);
+			found_edges = q != line_end && *q == '1' && (q + 1 == line_end || q[1] < '0' || q[1] > '9');
+			continue;
+		}
+
+		if (vertex_filtration.empty()) {
+			value_t value;
+			for (const char* q = p; parse_value(q, line_end, value);) vertex_filtration.push_back(value);
+		}
+	}
+	return std::min(p, end);
+}
+
+// Returns whether the first edge in [p, end) has three components (then there are also filtration values, which
+// we assume to come last), or -1 if there is no edge
+int first_flag_edge_has_filtration(const char* p, const char* end) {
+	for (const char* line_end; p < end; p = line_end + 1) {
+		line_end = end_of_line(p, end);
+		if (skip_blanks(p, line_end) == line_end || is_dimension_line(p, line_end)) continue;
+		return number_of_tokens(p, line_end) != 2;
+	}
+	return -1;
+}
+
+// Parses the lines of edges in [p, end) in parallel chunks and adds them in the order of the input, duplicate
+// edges are ignored
+void add_flag_edges(const char* p, const char* end, bool with_filtration, filtered_directed_graph_t& graph) {
+	std::array<const char*, PARALLEL_THREADS + 1> chunk_begin;
+	chunk_begin[0] = p;
+	chunk_begin[PARALLEL_THREADS] = end;
+	for (int t = 1; t < PARALLEL_THREADS; t++) {
+		const char* q = std::max(chunk_begin[t - 1], p + (end - p) / PARALLEL_THREADS * t);
+		chunk_begin[t] = q == p ? p : std::min(end, end_of_line(q, end) + 1);
+	}
+
+	std::array<flag_edges_t, PARALLEL_THREADS> chunks;
+	run_in_parallel([&](int t) {
+		parse_flag_edges(chunk_begin[t], chunk_begin[t + 1], with_filtration, graph.vertex_filtration, chunks[t]);
+	});
+	for (const auto& chunk : chunks)
+		if (!chunk.error.empty()) input_error(chunk.error);
+
+	for (auto& chunk : chunks) {
+		graph.add_filtered_edges(chunk.edges.data(), with_filtration ? chunk.filtration.data() : nullptr,
+		                         chunk.edges.size() / 2);
+		flag_edges_t().edges.swap(chunk.edges);
+		flag_edges_t().filtration.swap(chunk.filtration);
+	}
+}
+
+// Reads a .flag file from the standard input in a single pass, block by block
+filtered_directed_graph_t read_graph_flagser_from_stream(input_stream_t& stream, bool directed) {
+	std::vector<value_t> vertex_filtration;
+	bool found_edges = false;
+	const char *first = nullptr, *last = nullptr;
+	while (!found_edges && stream.next_lines(first, last))
+		first = read_flag_header(first, last, vertex_filtration, found_edges);
+
+	filtered_directed_graph_t graph(vertex_filtration, directed);
+	if (!found_edges) return graph;
+
+	int with_filtration = first_flag_edge_has_filtration(first, last);
+	do {
+		if (with_filtration == -1) with_filtration = first_flag_edge_has_filtration(first, last);
+		if (with_filtration != -1) add_flag_edges(first, last, with_filtration, graph);
+	} while (stream.next_lines(first, last));
+
+	return graph;
+}
+
+filtered_directed_graph_t read_graph_flagser(const std::string filename, const named_arguments_t& named_arguments) {
+	bool directed = std::string(get_argument_or_default(named_arguments, "undirected", "directed")) != "true";
+
+	if (filename == STANDARD_INPUT_FILENAME) {
+		input_stream_t stream(STDIN_FILENO);
+		return read_graph_flagser_from_stream(stream, directed);
+	}
+
+	mapped_file_t file(filename);
+	std::vector<value_t> vertex_filtration;
+	bool found_edges = false;
+	const char* p = read_flag_header(file.begin(), file.end(), vertex_filtration, found_edges);
+
+	filtered_directed_graph_t graph(vertex_filtration, directed);
+	add_flag_edges(p, file.end(), first_flag_edge_has_filtration(p, file.end()) == 1, graph);
+	return graph;
+}
+
+// Writes the graph in the .flag format, the filtration values are written with enough digits to be read back exactly
+void write_graph_flagser(const filtered_directed_graph_t& graph, std::ostream& stream) {
+	stream << std::setprecision(std::numeric_limits<value_t>::max_digits10);
+	stream << "dim 0\n";
+	for (size_t v = 0; v < graph.vertex_filtration.size(); v++) stream << (v > 0 ? " " : "") << graph.vertex_filtration[v];
+	stream << "\ndim 1\n";
+
+	const bool with_edge_filtration = graph.edge_filtration.size() == graph.edge_number();
+	for (size_t e = 0; e < graph.edge_number(); e++) {
+		stream << graph.edges[2 * e] << " " << graph.edges[2 * e + 1];
+		if (with_edge_filtration) stream << " " << graph.edge_filtration[e];
+		stream << "\n";
+	}
+}
@@ -5,15 +5,15 @@
 #ifndef WITH_HDF5
 
 filtered_directed_graph_t read_graph_h5(const std::string, const named_arguments_t&) {
-	std::cerr << "Error: flagser was compiled without support for .h5-files. Please install the HDF5-library "
-	             "(https://support.hdfgroup.org/HDF5/) and rebuild flagser by running \"make\" again."
-	          << std::endl;
-	exit(-1);
+	input_error("Error: flagser was compiled without support for .h5-files. Please install the HDF5-library "
+	            "(https://support.hdfgroup.org/HDF5/) and rebuild flagser by running \"make\" again.");
 }
 
 #else
 
+#include <algorithm>
 #include <hdf5.h>
+#include <mutex>
 #include <regex>
 #include <string>
 
@@ -68,15 +68,246 @@ herr_t extract_groups(hid_t group_id, const char* name, const H5L_info_t* info,
 	return (*extractor)(name);
 }
 
+// Dense matrices are read in blocks of rows and the datasets of sparse matrices in pieces, each of at most
+// this many bytes, so that the memory needed while reading only depends on the number of edges
+const size_t H5_READ_BLOCK_BYTES = 64 << 20;
+
+void exit_with_missing_h5_data(const std::string& h5_path) {
+	input_error("\n\nThe connectivity data could not be found at \"", h5_path, "\", please check the path again.");
+}
+
+std::vector<hsize_t> get_h5_dimensions(hid_t dataset_id) {
+	auto space = H5Dget_space(dataset_id);
+	std::vector<hsize_t> dimensions(std::max(H5Sget_simple_extent_ndims(space), 0));
+	H5Sget_simple_extent_dims(space, dimensions.data(), nullptr);
+	H5Sclose(space);
+	return dimensions;
+}
+
+// Reads the block of the dataset starting at `start` with the size `count` into buffer
+void read_h5_hyperslab(hid_t dataset_id, hid_t memory_type, int rank, const hsize_t* start, const hsize_t* count,
+                       void* buffer) {
+	auto file_space = H5Dget_space(dataset_id);
+	auto memory_space = H5Screate_simple(rank, count, nullptr);
+	H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, nullptr, count, nullptr);
+	const auto status = H5Dread(dataset_id, memory_type, memory_space, file_space, H5P_DEFAULT, buffer);
+	H5Sclose(memory_space);
+	H5Sclose(file_space);
+	if (status < 0) {
+		input_error("Could not read the connectivity data from the HDF5-file.");
+	}
+}
+
+// Calls f(row, values) for every row of the square matrix stored in the two-dimensional dataset
+template <typename T, typename Func> void read_h5_matrix_rows(hid_t dataset_id, hid_t memory_type, Func f) {
+	const auto dimensions = get_h5_dimensions(dataset_id);
+	if (dimensions.size() != 2) {
+		input_error("The connectivity matrix in the HDF5-file needs to be two-dimensional.");
+	}
+	if (dimensions[0] == 0 || dimensions[1] == 0) return;
+
+	const hsize_t rows_per_block =
+	    std::max(hsize_t(1), std::min(dimensions[0], hsize_t(H5_READ_BLOCK_BYTES / (sizeof(T) * dimensions[1]))));
+	std::vector<T> buffer(rows_per_block * dimensions[1]);
+	for (hsize_t first_row = 0; first_row < dimensions[0]; first_row += rows_per_block) {
+		const hsize_t start[2] = {first_row, 0};
+		const hsize_t count[2] = {std::min(rows_per_block, dimensions[0] - first_row), dimensions[1]};
+		read_h5_hyperslab(dataset_id, memory_type, 2, start, count, buffer.data());
+		for (hsize_t row = 0; row < count[0]; row++) f(first_row + row, &buffer[row * dimensions[1]]);
+	}
+}
+
+// Calls f(offset, count) after reading the next piece of each of the one-dimensional datasets into the
+// buffers, all datasets need to have the same length
+template <typename Func>
+void read_h5_vectors_in_pieces(const std::vector<hid_t>& dataset_ids, const std::vector<hid_t>& memory_types,
+                               const std::vector<void*>& buffers, size_t piece_length, Func f) {
+	const auto length = get_h5_dimensions(dataset_ids[0]);
+	for (auto dataset_id : dataset_ids) {
+		if (get_h5_dimensions(dataset_id) != length || length.size() != 1) {
+			input_error("The sparse connectivity data in the HDF5-file has inconsistent dimensions.");
+		}
+	}
+
+	for (hsize_t offset = 0; offset < length[0]; offset += piece_length) {
+		const hsize_t count = std::min(hsize_t(piece_length), length[0] - offset);
+		for (size_t i = 0; i < dataset_ids.size(); i++)
+			read_h5_hyperslab(dataset_ids[i], memory_types[i], 1, &offset, &count, buffers[i]);
+		f(offset, count);
+	}
+}
+
+// Reads the number of rows from the attribute "shape" (as written by e.g. scipy or anndata), returns 0 if
+// there is no such attribute
+uint64_t read_h5_shape(hid_t group_id) {
+	if (H5Aexists(group_id, "shape") <= 0) return 0;
+	auto attribute_id = H5Aopen(group_id, "shape", H5P_DEFAULT);
+	auto space = H5Aget_space(attribute_id);
+	std::vector<uint64_t> shape(std::max<hssize_t>(H5Sget_simple_extent_npoints(space), 1), 0);
+	H5Aread(attribute_id, H5T_NATIVE_UINT64, shape.data());
+	H5Sclose(space);
+	H5Aclose(attribute_id);
+	return shape[0];
+}
+
+// The entries of the sparse matrices are interpreted like the ones of a dense matrix: with a filtration, the
+// diagonal contains the vertex filtration and every non-zero entry is an edge with this filtration value.
+// Without a filtration, every non-zero entry is an edge.
+struct h5_sparse_entry_adder_t {
+	filtered_directed_graph_t& graph;
+	bool with_filtration;
+	const std::string& h5_path;
+	graph_edge_buffer_t edges;
+
+	h5_sparse_entry_adder_t(filtered_directed_graph_t& _graph, bool _with_filtration, const std::string& _h5_path)
+	    : graph(_graph), with_filtration(_with_filtration), h5_path(_h5_path), edges(_graph, _with_filtration) {}
+
+	inline void add(uint64_t x, uint64_t y, value_t value) {
+		if (x >= graph.vertex_number() || y >= graph.vertex_number()) {
+			input_error("The sparse connectivity data at \"", h5_path, "\" contains the entry (", x, ", ", y,
+			            "), but there are only ", graph.vertex_number(), " vertices.");
+		}
+
+		if (with_filtration) {
+			if (x == y) graph.vertex_filtration[x] = value;
+			if (value != 0) edges.add(vertex_index_t(x), vertex_index_t(y), value);
+		} else if (value != 0) {
+			edges.add(vertex_index_t(x), vertex_index_t(y));
+		}
+	}
+};
+
+// CSR layout: the group contains the datasets "indptr" (number of vertices + 1 entries), "indices" and
+// optionally "data" (the value of every entry, otherwise all entries are 1)
+filtered_directed_graph_t read_graph_h5_csr(hid_t group_id, const std::string& h5_path, bool directed,
+                                            bool with_filtration) {
+	if (H5Lexists(group_id, "indptr", H5P_DEFAULT) <= 0 || H5Lexists(group_id, "indices", H5P_DEFAULT) <= 0)
+		exit_with_missing_h5_data(h5_path);
+	auto indptr_id = H5Dopen(group_id, "indptr", H5P_DEFAULT);
+	auto indices_id = H5Dopen(group_id, "indices", H5P_DEFAULT);
+	const bool has_data = H5Lexists(group_id, "data", H5P_DEFAULT) > 0;
+
+	const auto indptr_dimensions = get_h5_dimensions(indptr_id);
+	if (indptr_dimensions.size() != 1 || indptr_dimensions[0] == 0) {
+		input_error("The dataset \"indptr\" at \"", h5_path, "\" needs to be a non-empty vector.");
+	}
+	std::vector<uint64_t> indptr(indptr_dimensions[0]);
+	H5Dread(indptr_id, H5T_NATIVE_UINT64, H5S_ALL, H5S_ALL, H5P_DEFAULT, indptr.data());
+	H5Dclose(indptr_id);
+
+	filtered_directed_graph_t graph(std::vector<value_t>(indptr.size() - 1, 0), directed);
+	h5_sparse_entry_adder_t adder{graph, with_filtration, h5_path};
+
+	const size_t piece_length = H5_READ_BLOCK_BYTES / (sizeof(uint64_t) + sizeof(value_t));
+	std::vector<uint64_t> indices(piece_length);
+	std::vector<value_t> data(has_data ? piece_length : 0);
+	std::vector<hid_t> dataset_ids{indices_id};
+	std::vector<hid_t> memory_types{H5T_NATIVE_UINT64};
+	std::vector<void*> buffers{indices.data()};
+	if (has_data) {
+		dataset_ids.push_back(H5Dopen(group_id, "data", H5P_DEFAULT));
+		memory_types.push_back(H5T_NATIVE_FLOAT);
+		buffers.push_back(data.data());
+	}
+
+	uint64_t row = 0;
+	read_h5_vectors_in_pieces(dataset_ids, memory_types, buffers, piece_length, [&](hsize_t offset, hsize_t count) {
+		for (hsize_t e = 0; e < count; e++) {
+			while (row + 1 < indptr.size() && indptr[row + 1] <= offset + e) row++;
+			adder.add(row, indices[e], has_data ? data[e] : 1);
+		}
+	});
+	adder.edges.flush();
+
+	for (auto dataset_id : dataset_ids) H5Dclose(dataset_id);
+	return graph;
+}
+
+// COO layout: the group contains the datasets "row", "col" and optionally "data" (the value of every entry,
+// otherwise all entries are 1). The number of vertices is taken from the attribute "shape" if it exists.
+filtered_directed_graph_t read_graph_h5_coo(hid_t group_id, const std::string& h5_path, bool directed,
+                                            bool with_filtration) {
+	if (H5Lexists(group_id, "row", H5P_DEFAULT) <= 0 || H5Lexists(group_id, "col", H5P_DEFAULT) <= 0)
+		exit_with_missing_h5_data(h5_path);
+	const bool has_data = H5Lexists(group_id, "data", H5P_DEFAULT) > 0;
+
+	const size_t piece_length = H5_READ_BLOCK_BYTES / (2 * sizeof(uint64_t) + sizeof(value_t));
+	std::vector<uint64_t> rows(piece_length);
+	std::vector<uint64_t> columns(piece_length);
+	std::vector<value_t> data(has_data ? piece_length : 0);
+	std::vector<hid_t> dataset_ids{H5Dopen(group_id, "row", H5P_DEFAULT), H5Dopen(group_id, "col", H5P_DEFAULT)};
+	std::vector<hid_t> memory_types{H5T_NATIVE_UINT64, H5T_NATIVE_UINT64};
+	std::vector<void*> buffers{rows.data(), columns.data()};
+
+	uint64_t number_of_vertices = read_h5_shape(group_id);
+	if (number_of_vertices == 0) {
+		read_h5_vectors_in_pieces(dataset_ids, memory_types, buffers, piece_length, [&](hsize_t, hsize_t count) {
+			for (hsize_t e = 0; e < count; e++)
+				number_of_vertices = std::max(number_of_vertices, std::max(rows[e], columns[e]) + 1);
+		});
+	}
+
+	if (has_data) {
+		dataset_ids.push_back(H5Dopen(group_id, "data", H5P_DEFAULT));
+		memory_types.push_back(H5T_NATIVE_FLOAT);
+		buffers.push_back(data.data());
+	}
+
+	filtered_directed_graph_t graph(std::vector<value_t>(number_of_vertices, 0), directed);
+	h5_sparse_entry_adder_t adder{graph, with_filtration, h5_path};
+	read_h5_vectors_in_pieces(dataset_ids, memory_types, buffers, piece_length, [&](hsize_t, hsize_t count) {
+		for (hsize_t e = 0; e < count; e++) adder.add(rows[e], columns[e], has_data ? data[e] : 1);
+	});
+	adder.edges.flush();
+
+	for (auto dataset_id : dataset_ids) H5Dclose(dataset_id);
+	return graph;
+}
+
+// Adds the edges of the dense matrix in the dataset, its rows and columns correspond to the vertices
+// starting at row_offset and column_offset. The diagonal contains the vertex filtration. For the grouped
+// matrices only positive filtration values (or entries equal to one without filtration) are edges.
+void read_h5_dense_block(hid_t dataset_id, filtered_directed_graph_t& graph, bool with_filtration, bool grouped,
+                         vertex_index_t row_offset, vertex_index_t column_offset, hsize_t rows, hsize_t columns,
+                         hid_t enumtype, const std::string& h5_path) {
+	const auto dimensions = get_h5_dimensions(dataset_id);
+	if (dimensions.size() != 2 || dimensions[0] != rows || dimensions[1] != columns) {
+		input_error("The connectivity matrices at \"", h5_path, "\" have inconsistent dimensions.");
+	}
+
+	graph_edge_buffer_t edges(graph, with_filtration);
+	if (with_filtration) {
+		read_h5_matrix_rows<value_t>(dataset_id, H5T_NATIVE_FLOAT, [&](hsize_t x, const value_t* row) {
+			const vertex_index_t v = vertex_index_t(row_offset + x);
+			for (hsize_t y = 0; y < columns; y++) {
+				const vertex_index_t w = vertex_index_t(column_offset + y);
+				if (v == w) graph.vertex_filtration[v] = row[y];
+				if (grouped ? row[y] > 0 : row[y] != 0) edges.add(v, w, row[y]);
+			}
+		});
+	} else {
+		auto type = H5Dget_type(dataset_id);
+		const hid_t memory_type = H5Tget_class(type) == H5T_ENUM ? enumtype : H5T_NATIVE_INT;
+		H5Tclose(type);
+		read_h5_matrix_rows<int>(dataset_id, memory_type, [&](hsize_t x, const int* row) {
+			for (hsize_t y = 0; y < columns; y++)
+				if (grouped ? row[y] == 1 : row[y] != 0)
+					edges.add(vertex_index_t(row_offset + x), vertex_index_t(column_offset + y));
+		});
+	}
+	edges.flush();
+}
+
 const filtered_directed_graph_t read_graph_h5(const std::string filename, const named_arguments_t& named_arguments) {
-	filtered_directed_graph_t* graph;
-	int current_dimension = 0;
-	std::vector<value_t> vertex_filtration;
 	std::string type = get_argument_or_default(named_arguments, "h5-type", "matrix");
 	bool directed = std::string(get_argument_or_default(named_arguments, "undirected", "directed")) != "true";
 	bool with_filtration = std::string(get_argument_or_default(named_arguments, "filtration",
 	                                                           "no-filtration-specified")) != "no-filtration-specified";
 
+	// The HDF5-library is not thread-safe, but the batch mode reads several graphs at once
+	static std::mutex h5_mutex;
+	std::lock_guard<std::mutex> lock(h5_mutex);
+
 	size_t h5_pos = filename.rfind(".h5");
 	std::string fname = filename;
 	std::string h5_path = "/";
@@ -86,85 +317,49 @@ const filtered_directed_graph_t read_graph_h5(const std::string filename, const
 	}
 
 	if (!H5Fis_hdf5(fname.c_str())) {
-		std::cerr << "The file \"" << fname << "\" is not an HDF5-file. Please choose another input format."
-		          << std::endl;
-		exit(-1);
+		input_error("The file \"", fname, "\" is not an HDF5-file. Please choose another input format.");
 	}
 
 	auto file_id = H5Fopen(fname.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
 
+	// Connectivity matrices of booleans are read as integers
+	hid_t enumtype = H5Tcreate(H5T_ENUM, sizeof(int));
+	int val = 0;
+	H5Tenum_insert(enumtype, "FALSE", &val);
+	val = 1;
+	H5Tenum_insert(enumtype, "TRUE", &val);
+
+	filtered_directed_graph_t graph(std::vector<value_t>(), directed);
 	if (type == "matrix") {
 		auto dataset_id = H5Dopen(file_id, h5_path.c_str(), H5P_DEFAULT);
+		if (dataset_id == -1) exit_with_missing_h5_data(h5_path);
 
-		if (dataset_id == -1) {
-			std::cerr << "\n\nThe connectivity data could not be found at \"" << h5_path
-			          << "\", please check the path again." << std::endl;
-			exit(1);
-		}
-
-		// Read the number of vertices
-		size_t vertex_number;
-		{
-			auto space = H5Dget_space(dataset_id);
-			hsize_t dim[2];
-			hsize_t maxdim[2];
-			auto size = H5Sget_simple_extent_dims(space, dim, maxdim);
-			vertex_number = dim[0];
-			H5Sclose(space);
+		const auto dimensions = get_h5_dimensions(dataset_id);
+		if (dimensions.size() != 2 || dimensions[0] != dimensions[1]) {
+			input_error("The connectivity matrix at \"", h5_path, "\" needs to be a square matrix.");
 		}
 
 		// We now know the number of vertices
-		graph = new filtered_directed_graph_t(std::vector<value_t>(vertex_number), directed);
+		graph = filtered_directed_graph_t(std::vector<value_t>(dimensions[0]), directed);
+		read_h5_dense_block(dataset_id, graph, with_filtration, false, 0, 0, dimensions[0], dimensions[1], enumtype,
+		                    h5_path);
 
-		if (with_filtration) {
-			value_t* entries = new value_t[vertex_number * vertex_number];
-			H5Dread(dataset_id, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, entries);
+		H5Dclose(dataset_id);
+	} else if (type == "csr" || type == "coo") {
+		auto group_id = H5Gopen(file_id, h5_path.c_str(), H5P_DEFAULT);
+		if (group_id == -1) exit_with_missing_h5_data(h5_path);
 
-			// Add the edges
-			for (int x = 0; x < vertex_number; x++) {
-        graph->vertex_filtration[x] = entries[x * vertex_number + x];
+		graph = type == "csr" ? read_graph_h5_csr(group_id, h5_path, directed, with_filtration)
+		                      : read_graph_h5_coo(group_id, h5_path, directed, with_filtration);
 
-				for (int y = 0; y < vertex_number; y++) {
-					if (entries[x * vertex_number + y] != 0)
-						graph->add_filtered_edge(x, y, entries[x * vertex_number + y]);
-				}
-			}
-		} else {
-			hid_t enumtype = H5Tcreate(H5T_ENUM, sizeof(index_t));
-			index_t val = 0;
-			H5Tenum_insert(enumtype, "FALSE", &val);
-			val = 1;
-			H5Tenum_insert(enumtype, "TRUE", &val);
-
-			index_t* entries = new index_t[vertex_number * vertex_number];
-			auto type = H5Dget_type(dataset_id);
-			H5Dread(dataset_id, H5Tget_class(type) == H5T_ENUM ? enumtype : H5T_NATIVE_INT, H5S_ALL, H5S_ALL,
-			        H5P_DEFAULT, entries);
-			H5Tclose(type);
-
-			// Add the edges
-			for (int x = 0; x < vertex_number; x++) {
-				for (int y = 0; y < vertex_number; y++) {
-					if (entries[x * vertex_number + y] != 0) graph->add_edge(x, y);
-				}
-			}
-
-			delete[] entries;
-			H5Tclose(enumtype);
-		}
-
-		H5Dclose(dataset_id);
+		H5Gclose(group_id);
 	} else {
 		// type == "grouped" or type == "grouped:L1*,..."
 		std::string groups = type.length() >= 8 ? type.substr(8) : "";
 		if (groups == "") groups = "_____all";
 
 		auto connectivity_id = H5Gopen(file_id, h5_path.c_str(), H5P_DEFAULT);
-		if (connectivity_id == -1) {
-			std::cerr << "\n\nThe connectivity data could not be found at \"" << h5_path
-			          << "\", please check the path again." << std::endl;
-			exit(1);
-		}
+		if (connectivity_id == -1) exit_with_missing_h5_data(h5_path);
 
 		group_extractor_t group_extractor(groups);
 		H5Literate(connectivity_id, H5_INDEX_NAME, H5_ITER_NATIVE, NULL, &extract_groups, &group_extractor);
@@ -179,32 +374,17 @@ const filtered_directed_graph_t read_graph_h5(const std::string filename, const
 			name += group_extractor.group_names[i];
 			name += "/cMat";
 			auto dataset_id = H5Dopen(connectivity_id, name.c_str(), H5P_DEFAULT);
+			if (dataset_id == -1) exit_with_missing_h5_data(h5_path);
 
-			if (dataset_id == -1) {
-				std::cerr << "\n\nThe connectivity data could not be found at \"" << h5_path
-				          << "\", please check the path again." << std::endl;
-				exit(1);
-			}
-
-			auto space = H5Dget_space(dataset_id);
-			hsize_t dim[2];
-			hsize_t maxdim[2];
-			auto size = H5Sget_simple_extent_dims(space, dim, maxdim);
+			const auto dimensions = get_h5_dimensions(dataset_id);
 			group_offsets.push_back(offset);
-			group_sizes.push_back(dim[0]);
-			offset += dim[0];
-			H5Sclose(space);
+			group_sizes.push_back(dimensions[0]);
+			offset += dimensions[0];
 			H5Dclose(dataset_id);
 		}
 
 		// We now know the number of vertices
-		graph = new filtered_directed_graph_t(std::vector<value_t>(offset), directed);
-
-		hid_t enumtype = H5Tcreate(H5T_ENUM, sizeof(index_t));
-		index_t val = 0;
-		H5Tenum_insert(enumtype, "FALSE", &val);
-		val = 1;
-		H5Tenum_insert(enumtype, "TRUE", &val);
+		graph = filtered_directed_graph_t(std::vector<value_t>(offset), directed);
 
 		for (int i = 0; i < group_extractor.group_names.size(); i++) {
 			for (int j = 0; j < group_extractor.group_names.size(); j++) {
@@ -213,52 +393,20 @@ const filtered_directed_graph_t read_graph_h5(const std::string filename, const
 				name += group_extractor.group_names[j];
 				name += "/cMat";
 				auto dataset_id = H5Dopen(connectivity_id, name.c_str(), H5P_DEFAULT);
+				if (dataset_id == -1) exit_with_missing_h5_data(h5_path);
 
-				if (with_filtration) {
-					value_t* entries = new value_t[group_sizes[i] * group_sizes[j]];
-					H5Dread(dataset_id, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, entries);
-
-					// Add the edges
-					for (int x = 0; x < group_sizes[i]; x++) {
-            graph->vertex_filtration[group_offsets[i] + x] = entries[x * group_sizes[j] + x];
-
-						for (int y = 0; y < group_sizes[j]; y++) {
-							if (entries[x * group_sizes[j] + y] > 0) {
-								graph->add_filtered_edge(group_offsets[i] + x, group_offsets[j] + y,
-								                         entries[x * group_sizes[j] + y]);
-							}
-						}
-					}
-					delete[] entries;
-				} else {
-					index_t* entries = new index_t[group_sizes[i] * group_sizes[j]];
-					auto type = H5Dget_type(dataset_id);
-					H5Dread(dataset_id, H5Tget_class(type) == H5T_ENUM ? enumtype : H5T_NATIVE_INT, H5S_ALL, H5S_ALL,
-					        H5P_DEFAULT, entries);
-
-					// Add the edges
-					for (int x = 0; x < group_sizes[i]; x++) {
-						for (int y = 0; y < group_sizes[j]; y++) {
-							if (entries[x * group_sizes[j] + y] == 1) {
-								graph->add_edge(group_offsets[i] + x, group_offsets[j] + y);
-							}
-						}
-					}
-
-					H5Tclose(type);
-					delete[] entries;
-				}
+				read_h5_dense_block(dataset_id, graph, with_filtration, true, group_offsets[i], group_offsets[j],
+				                    group_sizes[i], group_sizes[j], enumtype, h5_path);
 				H5Dclose(dataset_id);
 			}
 		}
 
-		H5Tclose(enumtype);
-
 		H5Gclose(connectivity_id);
 	}
 
+	H5Tclose(enumtype);
 	H5Fclose(file_id);
 
-	return *graph;
+	return graph;
 }
 #endif
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include "../definitions.h"
 #include "../directed_graph.h"
 
+#include "binary.h"
 #include "flagser.h"
 #include "h5.h"
 
@@ -24,16 +25,18 @@ filtered_directed_graph_t read_filtered_directed_graph(std::string input_filenam
 	if (input_name == "h5" || strlen(get_argument_or_default(named_arguments, "h5-type", "")) > 0 ||
 	    (!argument_was_passed(named_arguments, "in-format") &&
 	     input_filename.rfind(".h5") != std::string::npos)) {
+		if (input_filename == STANDARD_INPUT_FILENAME)
+			input_error("HDF5-files can not be read from the standard input.");
 		return read_graph_h5(input_filename, named_arguments);
 	}
 	if (input_name == "flagser") return read_graph_flagser(input_filename, named_arguments);
+	if (input_name == "binary") return read_graph_binary(input_filename, named_arguments);
 
 #ifdef INDICATE_PROGRESS
 	std::cout << "\033[K";
 #endif
 
-	std::cerr << "The input format \"" << input_name << "\" could not be found." << std::endl;
-	exit(1);
+	input_error("The input format \"", input_name, "\" could not be found.");
 }
 
-std::vector<std::string> available_input_formats = {"flagser", "h5"};
\ No newline at end of file
+std::vector<std::string> available_input_formats = {"flagser", "h5", "binary"};
\ No newline at end of file
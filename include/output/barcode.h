@@ -17,8 +17,8 @@ template <typename Complex> class barcode_output_t : public file_output_t<Comple
 	index_t euler_characteristic = 0;
 
 public:
-	barcode_output_t(const named_arguments_t& named_arguments)
-	    : file_output_t<Complex>(named_arguments),
+	barcode_output_t(const named_arguments_t& named_arguments, std::ostream* stream = nullptr)
+	    : file_output_t<Complex>(named_arguments, stream),
 	      modulus(atoi(get_argument_or_default(named_arguments, "modulus", "2"))),
 	      min_dimension(atoi(get_argument_or_default(named_arguments, "min-dim", "0"))),
 	      max_dimension(atoi(get_argument_or_default(named_arguments, "max-dim", "65535"))) {}
@@ -34,41 +34,42 @@ public:
 
         bool computed_full_homology = min_dimension == 0 && max_dimension == std::numeric_limits<unsigned int>::max();
         if (computed_full_homology) {
-          file_output_t<Complex>::outstream << std::endl;
-          file_output_t<Complex>::outstream << "# Euler characteristic: " << cell_euler_characteristic << std::endl;
+          file_output_t<Complex>::out << '\n';
+          file_output_t<Complex>::out << "# Euler characteristic: " << cell_euler_characteristic << '\n';
         }
     }
 
-		file_output_t<Complex>::outstream << std::endl;
-		file_output_t<Complex>::outstream << "# Betti numbers:" << std::endl;
+		file_output_t<Complex>::out << '\n';
+		file_output_t<Complex>::out << "# Betti numbers:\n";
 		int dim = 0;
 		for (size_t idx = 0; idx < betti.size(); idx++) {
-			file_output_t<Complex>::outstream << "#\t\tdim H_" << (min_dimension + dim++) << " = " << betti[idx];
-			if (skipped[idx] > 0) file_output_t<Complex>::outstream << " (skipped " << skipped[idx] << ")";
-			file_output_t<Complex>::outstream << std::endl;
+			file_output_t<Complex>::out << "#\t\tdim H_" << (min_dimension + dim++) << " = " << betti[idx];
+			if (skipped[idx] > 0) file_output_t<Complex>::out << " (skipped " << skipped[idx] << ")";
+			file_output_t<Complex>::out << '\n';
 		}
 
     if (with_cell_counts) {
-        file_output_t<Complex>::outstream << std::endl;
-        file_output_t<Complex>::outstream << "# Cell counts:" << std::endl;
+        file_output_t<Complex>::out << '\n';
+        file_output_t<Complex>::out << "# Cell counts:\n";
         for (size_t i = std::max<unsigned int>(0, min_dimension - 1); i <= complex->top_dimension(); i++)
-          file_output_t<Complex>::outstream << "#\t\tdim C_" << i << " = " << complex->number_of_cells(i)
-                                            << std::endl;
+          file_output_t<Complex>::out << "#\t\tdim C_" << i << " = " << complex->number_of_cells(i) << '\n';
     }
+		file_output_t<Complex>::out.flush();
 	}
 	void computing_barcodes_in_dimension(unsigned int dimension) {
+		file_output_t<Complex>::out.flush();
 		if (dimension >= min_dimension && dimension <= max_dimension)
-			file_output_t<Complex>::outstream << "# persistence intervals in dimension " << dimension << std::endl;
+			file_output_t<Complex>::out << "# persistence intervals in dimension " << dimension << '\n';
 		current_dimension = dimension;
 	}
 	inline void new_barcode(value_t birth, value_t death) {
-		file_output_t<Complex>::outstream << " [" << birth << ", " << death << ")" << std::endl;
+		file_output_t<Complex>::out << " [" << birth << ", " << death << ")\n";
 	}
 	inline void new_infinite_barcode(value_t birth) {
-		file_output_t<Complex>::outstream << " [" << birth << ", )" << std::endl;
+		file_output_t<Complex>::out << " [" << birth << ", )\n";
 	}
 	inline void skipped_column(value_t birth) {
-		file_output_t<Complex>::outstream << " [?" << birth << ", ?)" << std::endl;
+		file_output_t<Complex>::out << " [?" << birth << ", ?)\n";
 	}
 	void betti_number(size_t _betti, size_t _skipped) {
 		const auto shifted_dimension = current_dimension - min_dimension;
@@ -79,6 +80,6 @@ public:
 		euler_characteristic += (shifted_dimension & 1 ? -1 : 1) * _betti;
 	}
 	void remaining_homology_is_trivial() {
-		file_output_t<Complex>::outstream << std::endl << "The remaining homology groups are trivial." << std::endl;
+		file_output_t<Complex>::out << '\n' << "The remaining homology groups are trivial.\n";
 	}
 };
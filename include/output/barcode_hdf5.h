@@ -14,11 +14,15 @@
 template <typename Complex> class barcode_hdf5_output_t : public output_t<Complex> {
 	hid_t file_id;
 	hid_t group_id;
+	hdf5_dataset_options_t options;
 
 	std::vector<hid_t> barcode_datasets;
 	std::vector<hid_t> skipped_datasets;
+	std::vector<size_t> barcode_rows;
+	std::vector<size_t> skipped_rows;
 	std::vector<value_t> barcode_buffer;
 	std::vector<value_t> skipped_buffer;
+	hdf5_writer_t writer;
 
 	Complex* complex;
 	unsigned int current_dimension = 0;
@@ -39,7 +43,8 @@ template <typename Complex> class barcode_hdf5_output_t : public output_t<Comple
 
 public:
 	barcode_hdf5_output_t(const named_arguments_t& named_arguments)
-	    : modulus(atoi(get_argument_or_default(named_arguments, "modulus", "2"))),
+	    : options(get_hdf5_dataset_options(named_arguments)),
+	      modulus(atoi(get_argument_or_default(named_arguments, "modulus", "2"))),
 	      min_dimension(atoi(get_argument_or_default(named_arguments, "min-dim", "0"))),
 	      max_dimension(atoi(get_argument_or_default(named_arguments, "max-dim", "65535"))),
 	      approximate_computation(argument_was_passed(named_arguments, "approximate")),
@@ -49,11 +54,12 @@ public:
 		    open_or_create_group(get_argument_or_fail(named_arguments, "out", "Please provide an output file."));
 		file_id = ids.first;
 		group_id = ids.second;
-		barcode_buffer.reserve(BUFFER_SIZE + 50);
-		skipped_buffer.reserve(BUFFER_SIZE + 50);
+		barcode_buffer.reserve(2 * options.chunk_rows * HDF5_CHUNKS_PER_WRITE);
+		skipped_buffer.reserve(options.chunk_rows * HDF5_CHUNKS_PER_WRITE);
 	}
 	~barcode_hdf5_output_t() {
-		for (int i = 0; i < barcode_datasets.size(); i++) flush_if_necessary(true);
+		flush_if_necessary(true);
+		writer.wait();
 		for (auto id : barcode_datasets) H5Dclose(id);
 		for (auto id : skipped_datasets) H5Dclose(id);
 		if (group_id != file_id) H5Gclose(group_id);
@@ -88,9 +94,10 @@ public:
 	virtual void print_aggregated_results() override {
 		bool computed_full_homology = total_cell_count.size() > 0 && min_dimension == 0 && max_dimension == std::numeric_limits<unsigned int>::max();
 
-		int first_dimension = std::max<unsigned int>(0, min_dimension - 1);
+		int first_dimension = first_dataset_dimension();
 		int last_dimension = total_top_dimension;
 
+		std::lock_guard<std::mutex> library_lock(writer.library_mutex);
 		const auto info_group_id = H5Gcreate2(group_id, "info", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
 		{
 			// Write dimension information
@@ -113,7 +120,7 @@ public:
 			const auto dataset = H5Dcreate2(info_group_id, "cell_counts", H5T_NATIVE_INT, dataspace, H5P_DEFAULT,
 			                                H5P_DEFAULT, H5P_DEFAULT);
 			int data[last_dimension - first_dimension + 1];
-			for (int i = first_dimension; i <= last_dimension; i++) data[i] = total_cell_count[i];
+			for (int i = first_dimension; i <= last_dimension; i++) data[i - first_dimension] = total_cell_count[i];
 			H5Dwrite(dataset, H5T_NATIVE_INT, dataspace, dataspace, H5P_DEFAULT, data);
 			H5Sclose(dataspace);
 			H5Dclose(dataset);
@@ -157,40 +164,20 @@ public:
 
 			if (dimension > min_dimension) flush_if_necessary(true);
 
-			const size_t index = dimension - std::max<unsigned int>(0, min_dimension - 1);
+			const size_t index = dimension - first_dataset_dimension();
+			std::lock_guard<std::mutex> library_lock(writer.library_mutex);
 			while (index >= barcode_datasets.size()) {
 				std::string s = "dimension_";
 				s += std::to_string(dimension);
 				const auto current_dim_group_id =
 				    H5Gcreate2(group_id, s.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
 
-				{
-					// Create an unlimited dataspace for the barcodes
-					hsize_t dims[2]{0, 2};
-					hsize_t max_dims[2]{H5S_UNLIMITED, 2};
-					hsize_t chunk_dims[2]{BUFFER_SIZE, 2};
-					const auto dataspace = H5Screate_simple(2, dims, max_dims);
-					auto prop = H5Pcreate(H5P_DATASET_CREATE);
-					H5Pset_chunk(prop, 2, chunk_dims);
-					barcode_datasets.push_back(H5Dcreate2(current_dim_group_id, "barcodes", H5T_NATIVE_FLOAT, dataspace,
-					                                      H5P_DEFAULT, prop, H5P_DEFAULT));
-					H5Pclose(prop);
-					H5Sclose(dataspace);
-				}
-
-				{
-					// Create an unlimited dataspace for the skipped columns
-					hsize_t dims[2]{0, 1};
-					hsize_t max_dims[2]{H5S_UNLIMITED, 1};
-					hsize_t chunk_dims[2]{BUFFER_SIZE, 1};
-					const auto dataspace = H5Screate_simple(2, dims, max_dims);
-					auto prop = H5Pcreate(H5P_DATASET_CREATE);
-					H5Pset_chunk(prop, 2, chunk_dims);
-					skipped_datasets.push_back(H5Dcreate2(current_dim_group_id, "skipped", H5T_NATIVE_FLOAT, dataspace,
-					                                      H5P_DEFAULT, prop, H5P_DEFAULT));
-					H5Pclose(prop);
-					H5Sclose(dataspace);
-				}
+				barcode_datasets.push_back(
+				    create_extendible_dataset(current_dim_group_id, "barcodes", H5T_NATIVE_FLOAT, 2, options));
+				skipped_datasets.push_back(
+				    create_extendible_dataset(current_dim_group_id, "skipped", H5T_NATIVE_FLOAT, 1, options));
+				barcode_rows.push_back(0);
+				skipped_rows.push_back(0);
 			}
 		}
 
@@ -230,59 +217,26 @@ public:
 	void remaining_homology_is_trivial() override {}
 
 private:
-	inline size_t current_dataset_index() { return current_dimension - std::max<unsigned int>(0, min_dimension - 1); }
+	// The barcodes of the dimensions from min_dimension - 1 on are stored
+	inline unsigned int first_dataset_dimension() const { return min_dimension > 0 ? min_dimension - 1 : 0; }
+	inline size_t current_dataset_index() { return current_dimension - first_dataset_dimension(); }
 
 	void flush_if_necessary(bool force = false) {
 		if (!output_bars) return;
 
-		if (force || barcode_buffer.size() >= 2 * BUFFER_SIZE) {
-			// Write data
-			size_t new_size = barcode_buffer.size() / 2;
-			const auto dataset = barcode_datasets[current_dataset_index()];
-			hsize_t dims[2];
-			{
-				hsize_t maxdim[2];
-				auto space = H5Dget_space(dataset);
-				const auto size = H5Sget_simple_extent_dims(space, dims, maxdim);
-				dims[0] += new_size;
-			}
+		const auto index = current_dataset_index();
+		if (index >= barcode_datasets.size()) return;
 
-			H5Dset_extent(dataset, dims);
-			auto filespace = H5Dget_space(dataset);
-			hsize_t offset[2]{dims[0] - new_size, 0};
-			hsize_t dimsext[2]{new_size, 2};
-			H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, dimsext, NULL);
-			auto memspace = H5Screate_simple(2, dimsext, NULL);
-			H5Dwrite(dataset, H5T_NATIVE_FLOAT, memspace, filespace, H5P_DEFAULT, &barcode_buffer[0]);
-			H5Sclose(memspace);
-			H5Sclose(filespace);
-
-			barcode_buffer.clear();
+		if (force || barcode_buffer.size() >= 2 * options.chunk_rows * HDF5_CHUNKS_PER_WRITE) {
+			const size_t new_rows = barcode_buffer.size() / 2;
+			writer.write_rows(barcode_datasets[index], H5T_NATIVE_FLOAT, barcode_rows[index], 2, barcode_buffer);
+			barcode_rows[index] += new_rows;
 		}
 
-		if (force || skipped_buffer.size() >= BUFFER_SIZE) {
-			// Write data
-			size_t new_size = skipped_buffer.size();
-			const auto dataset = skipped_datasets[current_dataset_index()];
-
-			hsize_t dims[2];
-			{
-				hsize_t maxdim[2];
-				auto space = H5Dget_space(dataset);
-				const auto size = H5Sget_simple_extent_dims(space, dims, maxdim);
-				dims[0] += new_size;
-			}
-			H5Dset_extent(dataset, dims);
-			auto filespace = H5Dget_space(dataset);
-			hsize_t offset[2]{dims[0] - new_size, 0};
-			hsize_t dimsext[2]{new_size, 1};
-			H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, dimsext, NULL);
-			auto memspace = H5Screate_simple(2, dimsext, NULL);
-			H5Dwrite(dataset, H5T_NATIVE_FLOAT, memspace, filespace, H5P_DEFAULT, &skipped_buffer[0]);
-			H5Sclose(memspace);
-			H5Sclose(filespace);
-
-			skipped_buffer.clear();
+		if (force || skipped_buffer.size() >= options.chunk_rows * HDF5_CHUNKS_PER_WRITE) {
+			const size_t new_rows = skipped_buffer.size();
+			writer.write_rows(skipped_datasets[index], H5T_NATIVE_FLOAT, skipped_rows[index], 1, skipped_buffer);
+			skipped_rows[index] += new_rows;
 		}
 	}
 };
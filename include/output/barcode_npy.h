@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "../argparser.h"
+#include "../definitions.h"
+#include "base.h"
+
+// The header of every .npy file has this size, so that the number of rows can be updated in place
+const size_t NPY_HEADER_SIZE = 128;
+// The number of rows that are collected before they are written
+const size_t NPY_BUFFER_ROWS = 1 << 16;
+
+template <typename T> std::string npy_type();
+template <> std::string npy_type<float>() { return "f4"; }
+template <> std::string npy_type<int64_t>() { return "i8"; }
+
+// A NumPy array file (format version 1.0) with a fixed number of columns, the rows are appended in blocks
+template <typename T> class npy_file_t {
+	std::ofstream file;
+	std::string filename;
+	size_t columns;
+	size_t rows = 0;
+	std::vector<T> buffer;
+
+public:
+	npy_file_t(const std::string& _filename, size_t _columns) : filename(_filename), columns(_columns) {
+		file.open(filename, std::ios::binary);
+		if (file.fail()) {
+			std::cerr << "couldn't open file " << filename << std::endl;
+			exit(-1);
+		}
+		write_header();
+		buffer.reserve(NPY_BUFFER_ROWS * columns);
+	}
+	~npy_file_t() { finish(); }
+
+	void append(const T* row) {
+		buffer.insert(buffer.end(), row, row + columns);
+		rows++;
+		if (buffer.size() >= NPY_BUFFER_ROWS * columns) write_buffer();
+	}
+
+	// Writes all rows appended so far and updates the shape in the header
+	void finish() {
+		write_buffer();
+		file.seekp(0);
+		write_header();
+		file.seekp(0, std::ios::end);
+		file.flush();
+		if (file.fail()) {
+			std::cerr << "couldn't write file " << filename << std::endl;
+			exit(-1);
+		}
+	}
+
+private:
+	void write_buffer() {
+		if (!buffer.empty()) file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(T));
+		buffer.clear();
+	}
+
+	void write_header() {
+		const uint16_t one = 1;
+		const char byte_order = *reinterpret_cast<const char*>(&one) == 1 ? '<' : '>';
+		const std::string shape =
+		    columns == 1 ? std::to_string(rows) + "," : std::to_string(rows) + ", " + std::to_string(columns);
+		std::string header = "{'descr': '" + std::string(1, byte_order) + npy_type<T>() +
+		                     "', 'fortran_order': False, 'shape': (" + shape + "), }";
+		// Magic string, version and the length of the header come first, the header ends with a newline
+		header.resize(NPY_HEADER_SIZE - 11, ' ');
+		header += '\n';
+		file.write("\x93NUMPY\x01\x00", 8);
+		file.put(char(header.size() & 0xff));
+		file.put(char(header.size() >> 8));
+		file.write(header.data(), header.size());
+	}
+};
+
+// Writes the barcodes into a directory of .npy files: dimension_<d>.npy contains the (birth, death) pairs of
+// dimension d as float32 array of shape (n, 2), with death = inf for infinite bars. The births of skipped
+// columns go to skipped_<d>.npy, and the Betti numbers and cell counts (of all dimensions, starting at zero)
+// to betti_numbers.npy and cell_counts.npy.
+template <typename Complex> class barcode_npy_output_t : public output_t<Complex> {
+	std::string directory;
+	Complex* complex;
+	unsigned int current_dimension = 0;
+	unsigned int min_dimension;
+	unsigned int max_dimension;
+	std::vector<std::unique_ptr<npy_file_t<value_t>>> barcodes;
+	std::vector<std::unique_ptr<npy_file_t<value_t>>> skipped_births;
+	std::vector<size_t> betti;
+
+	std::vector<size_t> total_betti;
+	std::vector<size_t> total_cell_count;
+
+public:
+	barcode_npy_output_t(const named_arguments_t& named_arguments)
+	    : directory(get_argument_or_fail(named_arguments, "out",
+	                                     "Please provide an output directory via \"--out directory\" .")),
+	      min_dimension(atoi(get_argument_or_default(named_arguments, "min-dim", "0"))),
+	      max_dimension(atoi(get_argument_or_default(named_arguments, "max-dim", "65535"))) {
+		struct stat info;
+		if (stat(directory.c_str(), &info) == 0) {
+			std::cerr << "The output file already exists, aborting." << std::endl;
+			exit(-1);
+		}
+		if (mkdir(directory.c_str(), 0755) != 0) {
+			std::cerr << "couldn't create the directory " << directory << std::endl;
+			exit(-1);
+		}
+	}
+
+	void set_complex(Complex* _complex) override { complex = _complex; }
+
+	void computing_barcodes_in_dimension(unsigned int dimension) override {
+		current_dimension = dimension;
+		if (dimension < min_dimension || dimension > max_dimension) return;
+
+		if (barcodes.size() <= dimension) barcodes.resize(dimension + 1);
+		if (barcodes[dimension] == nullptr)
+			barcodes[dimension].reset(
+			    new npy_file_t<value_t>(directory + "/dimension_" + std::to_string(dimension) + ".npy", 2));
+	}
+
+	inline void new_barcode(value_t birth, value_t death) override {
+		const value_t bar[2]{birth, death};
+		if (current_dimension < barcodes.size() && barcodes[current_dimension] != nullptr)
+			barcodes[current_dimension]->append(bar);
+	}
+	inline void new_infinite_barcode(value_t birth) override {
+		new_barcode(birth, std::numeric_limits<value_t>::infinity());
+	}
+	inline void skipped_column(value_t birth) override {
+		if (current_dimension < min_dimension || current_dimension > max_dimension) return;
+		if (skipped_births.size() <= current_dimension) skipped_births.resize(current_dimension + 1);
+		if (skipped_births[current_dimension] == nullptr)
+			skipped_births[current_dimension].reset(new npy_file_t<value_t>(
+			    directory + "/skipped_" + std::to_string(current_dimension) + ".npy", 1));
+		skipped_births[current_dimension]->append(&birth);
+	}
+
+	void betti_number(size_t _betti, size_t _skipped) override {
+		betti.resize(current_dimension + 1, 0);
+		betti[current_dimension] = _betti;
+	}
+
+	void finished(bool with_cell_counts = true) override {
+		for (auto& file : barcodes)
+			if (file != nullptr) file->finish();
+		for (auto& file : skipped_births)
+			if (file != nullptr) file->finish();
+
+		total_betti.resize(std::max(total_betti.size(), betti.size()), 0);
+		for (size_t idx = 0; idx < betti.size(); idx++) total_betti[idx] += betti[idx];
+		betti.clear();
+
+		if (with_cell_counts) {
+			total_cell_count.resize(std::max(total_cell_count.size(), complex->top_dimension() + 1), 0);
+			for (size_t i = 0; i <= complex->top_dimension(); i++) total_cell_count[i] += complex->number_of_cells(i);
+		}
+	}
+
+	void print_aggregated_results() override {
+		write_array(directory + "/betti_numbers.npy", total_betti);
+		if (total_cell_count.size() > 0) write_array(directory + "/cell_counts.npy", total_cell_count);
+	}
+
+private:
+	void write_array(const std::string& filename, const std::vector<size_t>& values) {
+		npy_file_t<int64_t> file(filename, 1);
+		for (auto value : values) {
+			const int64_t v = value;
+			file.append(&v);
+		}
+	}
+};
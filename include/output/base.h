@@ -5,9 +5,11 @@
 
 #include "../argparser.h"
 #include "../definitions.h"
+#include "text_writer.h"
 
 template <typename Complex> class output_t {
 public:
+	virtual ~output_t() {}
 	virtual void set_complex(Complex* complex){};
 	virtual void print(std::string s){};
 	virtual void finished(bool with_cell_counts){};
@@ -18,14 +20,24 @@ public:
 	virtual void betti_number(size_t _betti, size_t _skipped){};
 	virtual void remaining_homology_is_trivial(){};
 	virtual void print_aggregated_results(){};
+	// Adds the aggregated results of another output (of the same type) to the ones of this output
+	virtual void add_results_of(output_t<Complex>* other){};
 };
 
 template <typename Complex> class file_output_t : public output_t<Complex> {
+	std::ofstream file_stream;
+	std::ostream& outstream;
+
 protected:
-	std::ofstream outstream;
+	// The text is buffered, the outputs flush it at the end of every dimension
+	text_writer_t out;
 
 public:
-	file_output_t(const named_arguments_t& named_arguments) {
+	// Writes into the given stream if it is not null, otherwise into the file given by --out
+	file_output_t(const named_arguments_t& named_arguments, std::ostream* stream = nullptr)
+	    : outstream(stream != nullptr ? *stream : file_stream), out(outstream) {
+		if (stream != nullptr) return;
+
 		auto filename =
 		    get_argument_or_fail(named_arguments, "out", "Please provide an output filename via \"--out filename\" .");
 
@@ -35,12 +47,13 @@ public:
 			exit(-1);
 		}
 
-		outstream.open(filename);
-		if (outstream.fail()) {
+		file_stream.open(filename);
+		if (file_stream.fail()) {
 			std::cerr << "couldn't open file " << filename << std::endl;
 			exit(-1);
 		}
 	}
 
-	virtual void print(std::string s) { outstream << s; }
+	virtual void print(std::string s) { out << s; }
+	virtual void print_aggregated_results() { out.flush(); }
 };
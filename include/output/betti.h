@@ -17,15 +17,15 @@ template <typename Complex> class betti_output_t : public file_output_t<Complex>
 	bool approximate_computation;
 	bool aggregate_results = false;
 
-	static std::vector<size_t> total_betti;
-	static std::vector<size_t> total_skipped;
-	static std::vector<size_t> total_cell_count;
+	std::vector<size_t> total_betti;
+	std::vector<size_t> total_skipped;
+	std::vector<size_t> total_cell_count;
 
-	static size_t total_top_dimension;
+	size_t total_top_dimension = 0;
 
 public:
-	betti_output_t(const named_arguments_t& named_arguments)
-	    : file_output_t<Complex>(named_arguments),
+	betti_output_t(const named_arguments_t& named_arguments, std::ostream* stream = nullptr)
+	    : file_output_t<Complex>(named_arguments, stream),
 	      modulus(atoi(get_argument_or_default(named_arguments, "modulus", "2"))),
 	      min_dimension(atoi(get_argument_or_default(named_arguments, "min-dim", "0"))),
 	      max_dimension(atoi(get_argument_or_default(named_arguments, "max-dim", "65535"))),
@@ -44,49 +44,44 @@ public:
 	}
 
 	virtual void print_aggregated_results() override;
+	virtual void add_results_of(output_t<Complex>* other) override;
 };
 
-template <typename Complex> std::vector<size_t> betti_output_t<Complex>::total_betti;
-template <typename Complex> std::vector<size_t> betti_output_t<Complex>::total_skipped;
-template <typename Complex> std::vector<size_t> betti_output_t<Complex>::total_cell_count;
-
-template <typename Complex> size_t betti_output_t<Complex>::total_top_dimension = 0;
-
-void print_ordinary(std::ostream& outstream, int min_dimension, int max_dimension, int top_dimension,
+void print_ordinary(text_writer_t& outstream, int min_dimension, int max_dimension, int top_dimension,
                     std::vector<size_t> number_of_cells, std::vector<size_t> betti, std::vector<size_t> skipped,
                     bool approximate_computation, bool with_cell_counts) {
   if (with_cell_counts) {
       outstream << "# Cell counts (of dimensions between " << std::max(0, min_dimension - 1) << " and " << top_dimension
-                << "):" << std::endl;
+                << "):\n";
       for (int i = std::max(0, min_dimension - 1); i <= top_dimension; i++)
         outstream << number_of_cells[i] << (i < top_dimension ? " " : "");
-      outstream << std::endl;
+      outstream << '\n';
 
       index_t cell_euler_characteristic = 0;
       for (int i = 0; i <= top_dimension; i++) cell_euler_characteristic += (i % 2 == 1 ? -1 : 1) * number_of_cells[i];
 
       bool computed_full_homology = min_dimension == 0 && max_dimension == std::numeric_limits<unsigned int>::max();
       if (computed_full_homology) {
-        outstream << "# Euler characteristic:" << std::endl;
-        outstream << cell_euler_characteristic << std::endl;
+        outstream << "# Euler characteristic:\n";
+        outstream << cell_euler_characteristic << '\n';
       }
   }
 
 	if (approximate_computation) {
 		outstream << "# Skipped columns of the coboundary matrix (in dimensions between "
-		          << std::max(0, min_dimension - 1) << " and " << skipped.size() - 1 << "):" << std::endl;
+		          << std::max(0, min_dimension - 1) << " and " << skipped.size() - 1 << "):\n";
 		for (size_t idx = std::max(0, min_dimension - 1); idx < skipped.size(); idx++) {
 			outstream << skipped[idx] << (idx < betti.size() ? " " : "");
 		}
-		outstream << std::endl;
+		outstream << '\n';
 	}
 
-	outstream << "# Betti numbers (between " << min_dimension << " and " << (betti.size() - 1) << "):" << std::endl;
+	outstream << "# Betti numbers (between " << min_dimension << " and " << (betti.size() - 1) << "):\n";
 	for (size_t idx = min_dimension; idx < betti.size(); idx++) {
 		outstream << betti[idx] << (idx < betti.size() ? " " : "");
 	}
 
-	outstream << std::endl;
+	outstream << '\n';
 }
 
 template <typename Complex> void betti_output_t<Complex>::finished(bool with_cell_counts) {
@@ -96,25 +91,42 @@ template <typename Complex> void betti_output_t<Complex>::finished(bool with_cel
   if (with_cell_counts) {
       for (int i = 0; i <= complex->top_dimension(); i++) number_of_cells.push_back(complex->number_of_cells(i));
 
-      total_cell_count.resize(complex->top_dimension() + 1, 0);
+      total_cell_count.resize(std::max(total_cell_count.size(), complex->top_dimension() + 1), 0);
       for (int i = 0; i <= complex->top_dimension(); i++) total_cell_count[i] += complex->number_of_cells(i);
   } else {
     total_cell_count.resize(0);
   }
 
-  print_ordinary(file_output_t<Complex>::outstream, min_dimension, max_dimension, complex->top_dimension(),
+  print_ordinary(file_output_t<Complex>::out, min_dimension, max_dimension, complex->top_dimension(),
                  number_of_cells, betti, skipped, approximate_computation, with_cell_counts);
+  file_output_t<Complex>::out.flush();
 
-  total_betti.resize(betti.size(), 0);
+  total_betti.resize(std::max(total_betti.size(), betti.size()), 0);
   for (size_t idx = 0; idx < betti.size(); idx++) total_betti[idx] += betti[idx];
 
-  total_skipped.resize(skipped.size(), 0);
+  total_skipped.resize(std::max(total_skipped.size(), skipped.size()), 0);
   for (size_t idx = 0; idx < skipped.size(); idx++) total_skipped[idx] += skipped[idx];
 }
 
 template <typename Complex> void betti_output_t<Complex>::print_aggregated_results() {
-	if (!aggregate_results) return;
+	if (aggregate_results)
+		print_ordinary(file_output_t<Complex>::out, min_dimension, max_dimension, total_top_dimension,
+		               total_cell_count, total_betti, total_skipped, approximate_computation,
+		               total_cell_count.size() > 0);
+	file_output_t<Complex>::out.flush();
+}
 
-	print_ordinary(file_output_t<Complex>::outstream, min_dimension, max_dimension, total_top_dimension,
-	               total_cell_count, total_betti, total_skipped, approximate_computation, total_cell_count.size() > 0);
+template <typename Complex> void betti_output_t<Complex>::add_results_of(output_t<Complex>* other) {
+	auto* results = dynamic_cast<betti_output_t<Complex>*>(other);
+	if (results == nullptr) return;
+
+	// This behaves like calling finished for every complex of the other output
+	total_top_dimension = std::max(total_top_dimension, results->total_top_dimension);
+	const auto add = [](std::vector<size_t>& total, const std::vector<size_t>& other) {
+		total.resize(std::max(total.size(), other.size()), 0);
+		for (size_t idx = 0; idx < other.size(); idx++) total[idx] += other[idx];
+	};
+	add(total_cell_count, results->total_cell_count);
+	add(total_betti, results->total_betti);
+	add(total_skipped, results->total_skipped);
 }
@@ -11,83 +11,85 @@
 #include <hdf5.h>
 #include <regex>
 
+// Writes the lists of cells into the datasets Cells_1, Cells_2, ... (by dimension). The cells are handed over in
+// blocks by the hdf5_cell_buffer_t of the threads, so the order of the rows depends on the scheduling.
 class hdf5_output_t {
 	hid_t file_id;
 	hid_t group_id;
+	hdf5_dataset_options_t options;
 
+	std::mutex mutex;
 	std::vector<hid_t> datasets;
 	std::vector<size_t> sizes;
-	std::vector<std::vector<vertex_index_t>> buffer;
+	hdf5_writer_t writer;
 
 public:
-	hdf5_output_t(const named_arguments_t& named_arguments) {
+	hdf5_output_t(const named_arguments_t& named_arguments) : options(get_hdf5_dataset_options(named_arguments)) {
 		auto ids = open_or_create_group(
 		    get_argument_or_fail(named_arguments, "out", "Please provide an output file for the list of cells."));
 		file_id = ids.first;
 		group_id = ids.second;
 	}
 	~hdf5_output_t() {
-		for (int i = 0; i < datasets.size(); i++) flush(i + 2);
+		writer.wait();
 		for (auto id : datasets) H5Dclose(id);
 		if (group_id != file_id) H5Gclose(group_id);
 		H5Fclose(file_id);
 	}
 
-	void write_cell(vertex_index_t* first_vertex, int size) {
-		if (size < 2) return;
+	// The number of vertex indices of cells with the given number of vertices that are collected per block
+	size_t block_size(int size) const { return options.chunk_rows * HDF5_CHUNKS_PER_WRITE * size; }
 
-		if (size - 2 >= datasets.size()) prepare(size);
+	// Appends the cells (with the given number of vertices each), cells is empty afterwards. Can be called from
+	// several threads at the same time.
+	void write_cells(int size, std::vector<vertex_index_t>& cells) {
+		if (cells.empty()) return;
 
-		vertex_index_t* v = first_vertex;
-		for (int i = 0; i < size; ++i, ++v) buffer[size - 2].push_back(*v);
+		// The rows are reserved and queued under the lock, so the writer extends the datasets in order
+		std::lock_guard<std::mutex> lock(mutex);
+		if (size - 2 >= datasets.size()) prepare(size);
 
-		if (buffer[size - 2].size() == BUFFER_SIZE * size) flush(size);
+		const int idx = size - 2;
+		const size_t new_size = cells.size() / size;
+		writer.write_rows(datasets[idx], VERTEX_INDEX_TYPE, sizes[idx], size, cells);
+		sizes[idx] += new_size;
 	}
 
 private:
-	void flush(int size) {
-		int idx = size - 2;
-		// Write data
-		size_t new_size = buffer[idx].size() / size;
-		hsize_t dims[2]{sizes[idx] + new_size, (hsize_t)size};
-		H5Dset_extent(datasets[idx], dims);
-		auto filespace = H5Dget_space(datasets[idx]);
-		hsize_t offset[2]{sizes[idx], 0};
-		hsize_t dimsext[2]{new_size, (hsize_t)size};
-		H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, dimsext, NULL);
-		auto memspace = H5Screate_simple(2, dimsext, NULL);
-		H5Dwrite(datasets[idx], VERTEX_INDEX_TYPE, memspace, filespace, H5P_DEFAULT, &buffer[idx][0]);
-		H5Sclose(memspace);
-		H5Sclose(filespace);
-
-		sizes[idx] += buffer[idx].size() / size;
-		buffer[idx].clear();
-	}
-
 	inline void prepare(int size) {
+		std::lock_guard<std::mutex> library_lock(writer.library_mutex);
 		while (size - 2 >= datasets.size()) {
 			hsize_t dim = datasets.size() + 1;
-			// Create an unlimited dataspace
-			hsize_t dims[2]{0, 0};
-			hsize_t max_dims[2]{H5S_UNLIMITED, H5S_UNLIMITED};
-			hsize_t chunk_dims[2]{BUFFER_SIZE, dim + 1};
-			auto dataspace = H5Screate_simple(2, dims, max_dims);
-			auto prop = H5Pcreate(H5P_DATASET_CREATE);
-			H5Pset_chunk(prop, 2, chunk_dims);
-			std::string s = "Cells_";
-			s += std::to_string(dim);
-			datasets.push_back(
-			    H5Dcreate2(group_id, s.c_str(), VERTEX_INDEX_TYPE, dataspace, H5P_DEFAULT, prop, H5P_DEFAULT));
-			H5Pclose(prop);
-			H5Sclose(dataspace);
-
-			std::vector<vertex_index_t> b;
-			b.reserve(BUFFER_SIZE + 50);
-			buffer.push_back(b);
+			datasets.push_back(create_extendible_dataset(group_id, "Cells_" + std::to_string(dim), VERTEX_INDEX_TYPE,
+			                                             dim + 1, options));
 		}
 
 		sizes.resize(size - 1, 0);
 	}
 };
 
+// Collects the cells found by one thread and hands them to the output in blocks
+class hdf5_cell_buffer_t {
+	hdf5_output_t* output;
+	std::vector<std::vector<vertex_index_t>> buffer;
+
+public:
+	hdf5_cell_buffer_t(hdf5_output_t* _output) : output(_output) {}
+	~hdf5_cell_buffer_t() { flush(); }
+
+	void write_cell(vertex_index_t* first_vertex, int size) {
+		if (size < 2) return;
+
+		if (size - 2 >= buffer.size()) buffer.resize(size - 1);
+		auto& cells = buffer[size - 2];
+		cells.insert(cells.end(), first_vertex, first_vertex + size);
+
+		if (cells.size() >= output->block_size(size)) output->write_cells(size, cells);
+	}
+
+	void flush() {
+		for (size_t idx = 0; idx < buffer.size(); idx++) output->write_cells(idx + 2, buffer[idx]);
+	}
+};
+
 #endif
\ No newline at end of file
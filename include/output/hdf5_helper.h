@@ -1,16 +1,25 @@
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "../argparser.h"
 #include "../definitions.h"
 #include "../input/flagser.h"
 
 #include <hdf5.h>
 
 const int BUFFER_SIZE = 10000;
-#ifndef MANY_VERTICES
-const auto VERTEX_INDEX_TYPE = H5T_NATIVE_USHORT;
-#else
+// The number of chunks of a dataset that are collected before they are written
+const size_t HDF5_CHUNKS_PER_WRITE = 16;
+// The number of collected blocks that may wait for the writer before the computation has to wait
+const size_t HDF5_MAXIMAL_PENDING_WRITES = 4;
+// vertex_index_t has 32 bits in both configurations
 const auto VERTEX_INDEX_TYPE = H5T_NATIVE_UINT32;
-#endif
 
 std::pair<hid_t, hid_t> open_or_create_group(const std::string& filename) {
 	size_t h5_pos = filename.rfind(".h5");
@@ -67,4 +76,126 @@ std::pair<hid_t, hid_t> open_or_create_group(const std::string& filename) {
 	}
 
 	return std::make_pair(file_id, group_id);
-}
\ No newline at end of file
+}
+
+// The datasets of the outputs are extendible in the number of rows and stored in chunks of the given number of
+// rows, optionally with the shuffle and deflate filters
+struct hdf5_dataset_options_t {
+	hsize_t chunk_rows;
+	int compression;
+	bool shuffle;
+};
+
+hdf5_dataset_options_t get_hdf5_dataset_options(const named_arguments_t& named_arguments) {
+	hdf5_dataset_options_t options;
+	options.chunk_rows = std::max(1, atoi(get_argument_or_default(named_arguments, "h5-chunk-size", "10000")));
+	options.compression = atoi(get_argument_or_default(named_arguments, "h5-compression", "0"));
+	options.shuffle = argument_was_passed(named_arguments, "h5-shuffle");
+
+	if (options.compression < 0 || options.compression > 9) {
+		std::cerr << "The compression level has to be between 0 and 9." << std::endl;
+		exit(-1);
+	}
+	if (options.compression > 0 && H5Zfilter_avail(H5Z_FILTER_DEFLATE) <= 0) {
+		std::cerr << "The HDF5 library does not support compression." << std::endl;
+		exit(-1);
+	}
+	return options;
+}
+
+hid_t create_extendible_dataset(hid_t group_id, const std::string& name, hid_t type, hsize_t columns,
+                                const hdf5_dataset_options_t& options) {
+	hsize_t dims[2]{0, columns};
+	hsize_t max_dims[2]{H5S_UNLIMITED, columns};
+	hsize_t chunk_dims[2]{options.chunk_rows, columns};
+	const auto dataspace = H5Screate_simple(2, dims, max_dims);
+	auto prop = H5Pcreate(H5P_DATASET_CREATE);
+	H5Pset_chunk(prop, 2, chunk_dims);
+	if (options.shuffle) H5Pset_shuffle(prop);
+	if (options.compression > 0) H5Pset_deflate(prop, options.compression);
+	const auto dataset = H5Dcreate2(group_id, name.c_str(), type, dataspace, H5P_DEFAULT, prop, H5P_DEFAULT);
+	H5Pclose(prop);
+	H5Sclose(dataspace);
+	return dataset;
+}
+
+// Appends blocks of rows to extendible datasets in a background thread, so that the computation does not wait
+// for the disk (and the compression). The HDF5 library is not thread safe, so while the writer exists all
+// other calls into the library have to hold library_mutex.
+class hdf5_writer_t {
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<std::function<void()>> jobs;
+	bool stopping = false;
+
+public:
+	std::mutex library_mutex;
+
+private:
+	std::thread thread;
+
+public:
+	hdf5_writer_t() : thread([this]() { run(); }) {}
+	~hdf5_writer_t() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		changed.notify_all();
+		thread.join();
+	}
+
+	// Takes the rows (with the given number of columns) and writes them at first_row of the dataset, rows is
+	// empty afterwards
+	template <typename T>
+	void write_rows(hid_t dataset, hid_t type, hsize_t first_row, hsize_t columns, std::vector<T>& rows) {
+		if (rows.empty()) return;
+
+		auto data = std::make_shared<std::vector<T>>();
+		data->swap(rows);
+		rows.reserve(data->capacity());
+
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [this]() { return jobs.size() < HDF5_MAXIMAL_PENDING_WRITES; });
+		jobs.push_back([=]() {
+			const hsize_t new_rows = data->size() / columns;
+			hsize_t dims[2]{first_row + new_rows, columns};
+			H5Dset_extent(dataset, dims);
+			auto filespace = H5Dget_space(dataset);
+			hsize_t offset[2]{first_row, 0};
+			hsize_t dimsext[2]{new_rows, columns};
+			H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, dimsext, NULL);
+			auto memspace = H5Screate_simple(2, dimsext, NULL);
+			H5Dwrite(dataset, type, memspace, filespace, H5P_DEFAULT, data->data());
+			H5Sclose(memspace);
+			H5Sclose(filespace);
+		});
+		changed.notify_all();
+	}
+
+	// Waits until all blocks are written
+	void wait() {
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [this]() { return jobs.empty(); });
+	}
+
+private:
+	void run() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			changed.wait(lock, [this]() { return stopping || !jobs.empty(); });
+			if (jobs.empty()) return;
+
+			// The job stays in the queue until it is done, so that wait() does not return too early
+			auto job = jobs.front();
+			lock.unlock();
+			{
+				std::lock_guard<std::mutex> library_lock(library_mutex);
+				job();
+			}
+			lock.lock();
+			jobs.pop_front();
+			changed.notify_all();
+		}
+	}
+};
@@ -7,6 +7,7 @@
 
 #include "../argparser.h"
 #include "barcode.h"
+#include "barcode_npy.h"
 #include "base.h"
 #include "betti.h"
 
@@ -19,14 +20,30 @@ bool has_zero_filtration_and_no_explicit_output(const named_arguments_t& named_a
 	       std::string(get_argument_or_default(named_arguments, "filtration", "zero")) == "zero";
 }
 
-template <typename Complex> output_t<Complex>* get_output(const named_arguments_t& named_arguments) {
+// Whether the output can be written into a stream, see get_output
+bool output_can_be_combined(const named_arguments_t& named_arguments) {
+	const std::string output_name = get_argument_or_default(named_arguments, "out-format", "barcode");
+	return output_name != "barcode:hdf5" && output_name != "barcode:npy";
+}
+
+// If stream is not null, the output is written into it instead of the file given by --out, this is only
+// supported by the text formats
+template <typename Complex>
+output_t<Complex>* get_output(const named_arguments_t& named_arguments, std::ostream* stream = nullptr) {
 	std::string output_name = "barcode";
 	auto it = named_arguments.find("out-format");
 	if (it != named_arguments.end()) { output_name = it->second; }
 
 	if (output_name == "betti" || has_zero_filtration_and_no_explicit_output(named_arguments))
-		return new betti_output_t<Complex>(named_arguments);
-	if (output_name == "barcode") return new barcode_output_t<Complex>(named_arguments);
+		return new betti_output_t<Complex>(named_arguments, stream);
+	if (output_name == "barcode") return new barcode_output_t<Complex>(named_arguments, stream);
+
+	if (stream != nullptr && !output_can_be_combined(named_arguments)) {
+		std::cerr << "The output format \"" << output_name << "\" can not be combined into a single file." << std::endl;
+		exit(-1);
+	}
+
+	if (output_name == "barcode:npy") return new barcode_npy_output_t<Complex>(named_arguments);
 
 #ifdef WITH_HDF5
 	if (output_name == "barcode:hdf5") return new barcode_hdf5_output_t<Complex>(named_arguments);
@@ -36,7 +53,7 @@ template <typename Complex> output_t<Complex>* get_output(const named_arguments_
 	exit(1);
 }
 
-std::vector<std::string> available_output_formats = {"barcode", "betti"
+std::vector<std::string> available_output_formats = {"barcode", "betti", "barcode:npy"
 #ifdef WITH_HDF5
                                                      ,
                                                      "barcode:hdf5"
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../definitions.h"
+
+const size_t TEXT_WRITER_BUFFER_SIZE = 1 << 20;
+
+// Collects the text output in a large buffer that is only written to the stream when it is full or when flush
+// is called explicitly. Numbers are formatted without the locale machinery of the streams, but in the same
+// format as the default of std::ostream.
+class text_writer_t {
+	std::ostream& stream;
+	std::vector<char> buffer;
+	size_t used = 0;
+
+	char* reserve(size_t bytes) {
+		if (used + bytes > buffer.size()) write_buffer();
+		char* position = &buffer[used];
+		used += bytes;
+		return position;
+	}
+
+	void write_buffer() {
+		if (used > 0) stream.write(buffer.data(), used);
+		used = 0;
+	}
+
+	template <typename T> text_writer_t& write_unsigned(T value) {
+		char digits[24];
+		int length = 0;
+		do {
+			digits[length++] = char('0' + value % 10);
+			value /= 10;
+		} while (value > 0);
+		char* p = reserve(length);
+		while (length > 0) *p++ = digits[--length];
+		return *this;
+	}
+
+	template <typename T> text_writer_t& write_signed(T value) {
+		if (value >= 0) return write_unsigned((unsigned long long)value);
+		*reserve(1) = '-';
+		return write_unsigned(0ULL - (unsigned long long)value);
+	}
+
+public:
+	text_writer_t(std::ostream& _stream, size_t buffer_size = TEXT_WRITER_BUFFER_SIZE)
+	    : stream(_stream), buffer(buffer_size) {}
+	~text_writer_t() { flush(); }
+
+	// Writes the buffer into the stream and flushes the stream
+	void flush() {
+		write_buffer();
+		stream.flush();
+	}
+
+	text_writer_t& write(const char* s, size_t length) {
+		if (length > buffer.size()) {
+			write_buffer();
+			stream.write(s, length);
+			return *this;
+		}
+		memcpy(reserve(length), s, length);
+		return *this;
+	}
+
+	text_writer_t& operator<<(const char* s) { return write(s, strlen(s)); }
+	text_writer_t& operator<<(const std::string& s) { return write(s.data(), s.size()); }
+	text_writer_t& operator<<(char c) {
+		*reserve(1) = c;
+		return *this;
+	}
+
+	text_writer_t& operator<<(unsigned int value) { return write_unsigned(value); }
+	text_writer_t& operator<<(unsigned long value) { return write_unsigned(value); }
+	text_writer_t& operator<<(unsigned long long value) { return write_unsigned(value); }
+	text_writer_t& operator<<(int value) { return write_signed(value); }
+	text_writer_t& operator<<(long value) { return write_signed(value); }
+	text_writer_t& operator<<(long long value) { return write_signed(value); }
+
+	// Like std::ostream, this uses "%g" with six significant digits, integers below 10^6 are written directly.
+	// The sign of zero, infinity and NaN are read from the bits, as the build flags allow the compiler to assume
+	// that there are no such values (and converting them to an integer is undefined).
+	text_writer_t& operator<<(double value) {
+		uint64_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		const uint64_t exponent_bits = 0x7ffULL << 52;
+		if ((bits & exponent_bits) == exponent_bits) {
+			const bool negative = bits >> 63;
+			if (bits & ((uint64_t(1) << 52) - 1)) return *this << (negative ? "-nan" : "nan");
+			return *this << (negative ? "-inf" : "inf");
+		}
+		if (value > -1e6 && value < 1e6 && value == double(long(value)) && (value != 0 || bits == 0))
+			return write_signed(long(value));
+
+		char number[32];
+		const int length = snprintf(number, sizeof(number), "%g", value);
+		return write(number, length);
+	}
+	text_writer_t& operator<<(float value) { return *this << double(value); }
+};
@@ -4,21 +4,167 @@
 // #define USE_COEFFICIENTS
 // #define USE_GOOGLE_HASHMAP
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <deque>
 #include <iostream>
+#include <memory>
 #include <queue>
+#include <thread>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
 
 #include "definitions.h"
 #include "output/base.h"
 
-#ifdef USE_ARRAY_HASHMAP
-typedef std::deque<index_t> pivot_column_index_t;
 const index_t INVALID_INDEX = std::numeric_limits<index_t>::max();
+
+// Maps the pivot of a reduced column (a cell of the next dimension) to the position of that column.
+// There are two layouts:
+//  - a packed array with one entry per cell, where each entry only uses as many bits as are needed
+//    to store the column positions (the value 0 means "no column"),
+//  - an open-addressing hash table with linear probing, which is smaller if only a few cells are pivots.
+// Without USE_ARRAY_HASHMAP only the hash table is used.
+class pivot_column_index_t {
+public:
+	enum layout_t { PACKED_ARRAY, OPEN_ADDRESSING };
+
+	// The expected number of pivots is used to decide which layout needs less memory. The array layout is
+	// only chosen if the hash table would need more than half of its memory, because lookups in the array
+	// are a lot cheaper.
+	pivot_column_index_t(size_t number_of_cells, size_t number_of_columns, size_t expected_number_of_pivots) {
+		bits_per_entry = 1;
+		while (bits_per_entry < 64 && (uint64_t(1) << bits_per_entry) <= number_of_columns) bits_per_entry++;
+		entry_mask = bits_per_entry == 64 ? ~uint64_t(0) : (uint64_t(1) << bits_per_entry) - 1;
+
+		expected_number_of_pivots = std::min(expected_number_of_pivots, number_of_columns);
+
+#ifdef USE_ARRAY_HASHMAP
+		const size_t array_bytes = (number_of_cells * bits_per_entry + 63) / 64 * sizeof(uint64_t);
+		const size_t hash_bytes = 4 * sizeof(index_t) * expected_number_of_pivots;
+		layout = 2 * hash_bytes < array_bytes ? OPEN_ADDRESSING : PACKED_ARRAY;
 #else
-typedef fast_hash_map<index_t, index_t> pivot_column_index_t;
+		layout = OPEN_ADDRESSING;
 #endif
 
+		if (layout == PACKED_ARRAY)
+			packed_entries.resize((number_of_cells * bits_per_entry + 63) / 64, 0);
+		else
+			rehash(std::max(size_t(16), 2 * expected_number_of_pivots));
+	}
+
+	layout_t get_layout() const { return layout; }
+	size_t size() const { return number_of_pivots; }
+
+	// Returns the column with the given pivot, or INVALID_INDEX if there is none
+	inline index_t find(index_t pivot) const {
+		if (layout == PACKED_ARRAY) {
+			const uint64_t value = get_packed(pivot);
+			return value == 0 ? INVALID_INDEX : index_t(value - 1);
+		}
+
+		for (size_t position = hash(pivot);; position = (position + 1) & hash_mask) {
+			if (hash_keys[position] == pivot) return hash_values[position];
+			if (hash_keys[position] == INVALID_INDEX) return INVALID_INDEX;
+		}
+	}
+
+	inline bool contains(index_t pivot) const { return find(pivot) != INVALID_INDEX; }
+
+	// Calls f(pivot, column) for all pivots
+	template <typename Func> void for_each(Func f) const {
+		if (layout == PACKED_ARRAY) {
+			for (size_t pivot = 0; (pivot + 1) * bits_per_entry <= 64 * packed_entries.size(); pivot++) {
+				const uint64_t value = get_packed(pivot);
+				if (value != 0) f(index_t(pivot), index_t(value - 1));
+			}
+			return;
+		}
+
+		for (size_t i = 0; i < hash_keys.size(); i++)
+			if (hash_keys[i] != INVALID_INDEX) f(hash_keys[i], hash_values[i]);
+	}
+
+	// Note: Every pivot is only inserted once
+	inline void insert(index_t pivot, index_t column) {
+		number_of_pivots++;
+		if (layout == PACKED_ARRAY) {
+			set_packed(pivot, uint64_t(column) + 1);
+			return;
+		}
+
+		if (2 * number_of_pivots > hash_keys.size()) rehash(2 * hash_keys.size());
+		size_t position = hash(pivot);
+		while (hash_keys[position] != INVALID_INDEX) position = (position + 1) & hash_mask;
+		hash_keys[position] = pivot;
+		hash_values[position] = column;
+	}
+
+private:
+	layout_t layout;
+	size_t number_of_pivots = 0;
+
+	unsigned int bits_per_entry;
+	uint64_t entry_mask;
+	std::vector<uint64_t> packed_entries;
+
+	std::vector<index_t> hash_keys;
+	std::vector<index_t> hash_values;
+	size_t hash_mask = 0;
+	unsigned int hash_shift = 64;
+
+	inline uint64_t get_packed(index_t index) const {
+		const size_t bit = size_t(index) * bits_per_entry;
+		const size_t word = bit >> 6;
+		const unsigned int offset = bit & 63;
+		uint64_t value = packed_entries[word] >> offset;
+		if (offset + bits_per_entry > 64) value |= packed_entries[word + 1] << (64 - offset);
+		return value & entry_mask;
+	}
+
+	inline void set_packed(index_t index, uint64_t value) {
+		const size_t bit = size_t(index) * bits_per_entry;
+		const size_t word = bit >> 6;
+		const unsigned int offset = bit & 63;
+		packed_entries[word] = (packed_entries[word] & ~(entry_mask << offset)) | (value << offset);
+		if (offset + bits_per_entry > 64) {
+			const unsigned int shift = 64 - offset;
+			packed_entries[word + 1] = (packed_entries[word + 1] & ~(entry_mask >> shift)) | (value >> shift);
+		}
+	}
+
+	// Fibonacci hashing, the capacity is always a power of two
+	inline size_t hash(index_t key) const { return (uint64_t(key) * 0x9E3779B97F4A7C15ULL) >> hash_shift; }
+
+	void rehash(size_t minimal_capacity) {
+		size_t capacity = 16;
+		hash_shift = 60;
+		while (capacity < minimal_capacity) {
+			capacity <<= 1;
+			hash_shift--;
+		}
+
+		std::vector<index_t> old_keys(capacity, INVALID_INDEX);
+		std::vector<index_t> old_values(capacity);
+		std::swap(old_keys, hash_keys);
+		std::swap(old_values, hash_values);
+		hash_mask = capacity - 1;
+
+		for (size_t i = 0; i < old_keys.size(); i++) {
+			if (old_keys[i] == INVALID_INDEX) continue;
+			size_t position = hash(old_keys[i]);
+			while (hash_keys[position] != INVALID_INDEX) position = (position + 1) & hash_mask;
+			hash_keys[position] = old_keys[i];
+			hash_values[position] = old_values[i];
+		}
+	}
+};
+
 std::vector<coefficient_t> multiplicative_inverse_vector(const coefficient_t m) {
 	std::vector<coefficient_t> inverse(m);
 	inverse[1] = 1;
@@ -190,45 +336,80 @@ template <typename Heap> filtration_entry_t get_pivot(Heap& column, coefficient_
 	return result;
 }
 
+// The columns are stored one after another in a single array of entries, bounds[i] is the end of column i.
+// Instead of owning its arrays, the matrix can also refer to memory mapped from a file (see map).
 template <typename ValueType> class compressed_sparse_matrix {
-	std::deque<size_t> bounds;
-	std::deque<ValueType> entries;
+	std::vector<size_t> bounds;
+	std::vector<ValueType> entries;
+
+	std::shared_ptr<const void> mapping;
+	const size_t* mapped_bounds = nullptr;
+	const ValueType* mapped_entries = nullptr;
+	size_t mapped_columns = 0;
 
 public:
-	size_t size() const { return bounds.size(); }
+	size_t size() const { return mapping ? mapped_columns : bounds.size(); }
+	size_t number_of_entries() const { return size() == 0 ? 0 : bounds_data()[size() - 1]; }
+
+	const size_t* bounds_data() const { return mapping ? mapped_bounds : bounds.data(); }
+	const ValueType* entries_data() const { return mapping ? mapped_entries : entries.data(); }
 
 	void clear() {
 		bounds.clear();
 		bounds.shrink_to_fit();
 		entries.clear();
 		entries.shrink_to_fit();
+		mapping.reset();
+		mapped_bounds = nullptr;
+		mapped_entries = nullptr;
+		mapped_columns = 0;
+	}
+
+	// Uses the given arrays as bounds and entries, they have to stay valid as long as the mapping is alive
+	void map(std::shared_ptr<const void> _mapping, const size_t* _bounds, const ValueType* _entries, size_t columns) {
+		clear();
+		mapping = _mapping;
+		mapped_bounds = _bounds;
+		mapped_entries = _entries;
+		mapped_columns = columns;
 	}
 
-	typename std::deque<ValueType>::const_iterator cbegin(size_t index) const {
+	const ValueType* cbegin(size_t index) const {
 		assert(index < size());
-		return index == 0 ? entries.cbegin() : entries.cbegin() + bounds[index - 1];
+		return index == 0 ? entries_data() : entries_data() + bounds_data()[index - 1];
 	}
 
-	typename std::deque<ValueType>::const_iterator cend(size_t index) const {
+	const ValueType* cend(size_t index) const {
 		assert(index < size());
-		return entries.cbegin() + bounds[index];
+		return entries_data() + bounds_data()[index];
 	}
 
 	template <typename Iterator> void append_column(Iterator begin, Iterator end) {
+		assert(!mapping);
 		for (Iterator it = begin; it != end; ++it) { entries.push_back(*it); }
 		bounds.push_back(entries.size());
 	}
 
-	void append_column() { bounds.push_back(entries.size()); }
+	// Growing the arrays needs twice their memory for a moment, so they are allocated up front if the size is known
+	void reserve(size_t columns, size_t number_of_entries) {
+		assert(!mapping);
+		bounds.reserve(columns);
+		entries.reserve(number_of_entries);
+	}
+
+	void append_column() {
+		assert(!mapping);
+		bounds.push_back(entries.size());
+	}
 
 	void push_back(ValueType e) {
-		assert(0 < size());
+		assert(0 < size() && !mapping);
 		entries.push_back(e);
 		++bounds.back();
 	}
 
 	void pop_back() {
-		assert(0 < size());
+		assert(0 < size() && !mapping);
 		entries.pop_back();
 		--bounds.back();
 	}
@@ -238,21 +419,321 @@ public:
 	}
 };
 
+// Stores the columns of the reduction matrix of one dimension in large blocks. Only columns that are
+// actually used for reductions later on are stored: columns without a pivot are never looked up and
+// columns whose reduction is trivial (the column itself with coefficient one) are reconstructed by the
+// caller, both are stored as empty columns.
+// If the number of entries held in memory exceeds the given limit, full blocks are written to a
+// temporary file and read back when needed. Blocks never change after they are full, so every block is
+// written at most once.
+class reduction_matrix_t {
+	struct block_t {
+		size_t first_entry;
+		size_t size = 0;
+		long file_offset = -1;
+		size_t last_use = 0;
+		std::vector<filtration_entry_t> entries;
+	};
+
+	std::vector<size_t> bounds;
+	std::vector<block_t> blocks;
+	size_t block_size;
+	size_t max_resident_blocks;
+	size_t resident_blocks = 0;
+	size_t use_counter = 0;
+	std::FILE* spill_file = nullptr;
+
+public:
+	reduction_matrix_t(size_t max_resident_entries = std::numeric_limits<size_t>::max(),
+	                   size_t _block_size = 1 << 18)
+	    : block_size(_block_size), max_resident_blocks(std::max(size_t(2), max_resident_entries / _block_size)) {
+		blocks.push_back(block_t());
+		blocks.back().first_entry = 0;
+		blocks.back().entries.reserve(block_size);
+		resident_blocks++;
+	}
+	~reduction_matrix_t() {
+		if (spill_file != nullptr) std::fclose(spill_file);
+	}
+
+	size_t size() const { return bounds.size(); }
+
+	// Empty columns stand for trivial columns (or columns that are never looked up)
+	bool is_trivial(size_t index) const { return column_begin(index) == bounds[index]; }
+
+	// Returns the entries of a non-trivial column, the pointers are valid until the matrix is modified
+	// or another column is looked up
+	std::pair<const filtration_entry_t*, const filtration_entry_t*> column(size_t index) {
+		assert(index < size());
+		const size_t begin = column_begin(index);
+		size_t b = blocks.size() - 1;
+		while (blocks[b].first_entry > begin) b--;
+		load_block(b);
+		const filtration_entry_t* first = &blocks[b].entries[begin - blocks[b].first_entry];
+		return std::make_pair(first, first + (bounds[index] - begin));
+	}
+
+	void append_column() { bounds.push_back(bounds.empty() ? 0 : bounds.back()); }
+
+	void push_back(const filtration_entry_t& e) {
+		assert(0 < size());
+		block_t* tail = &blocks.back();
+		const size_t begin = column_begin(size() - 1);
+
+		// Columns do not cross block boundaries, so move the current column into a new block
+		if (tail->size >= block_size && begin > tail->first_entry) {
+			block_t block;
+			block.first_entry = begin;
+			block.entries.reserve(block_size);
+			block.entries.assign(tail->entries.begin() + (begin - tail->first_entry), tail->entries.end());
+			block.size = block.entries.size();
+			tail->entries.resize(begin - tail->first_entry);
+			tail->size = tail->entries.size();
+
+			blocks.push_back(block);
+			resident_blocks++;
+			evict_if_necessary(blocks.size() - 1);
+			tail = &blocks.back();
+		}
+
+		tail->entries.push_back(e);
+		tail->size++;
+		++bounds.back();
+	}
+
+	void pop_back() {
+		assert(0 < size() && !is_trivial(size() - 1));
+		blocks.back().entries.pop_back();
+		blocks.back().size--;
+		--bounds.back();
+	}
+
+	// Writes all columns into the file, read_columns appends them to an empty matrix again
+	bool write_columns(std::FILE* file) {
+		const uint64_t number_of_columns = size();
+		if (std::fwrite(&number_of_columns, sizeof(uint64_t), 1, file) != 1 ||
+		    std::fwrite(bounds.data(), sizeof(size_t), bounds.size(), file) != bounds.size())
+			return false;
+		for (size_t b = 0; b < blocks.size(); b++) {
+			if (blocks[b].size == 0) continue;
+			load_block(b);
+			if (std::fwrite(&blocks[b].entries[0], sizeof(filtration_entry_t), blocks[b].size, file) != blocks[b].size)
+				return false;
+		}
+		return true;
+	}
+
+	bool read_columns(std::FILE* file) {
+		uint64_t number_of_columns;
+		if (std::fread(&number_of_columns, sizeof(uint64_t), 1, file) != 1) return false;
+		std::vector<size_t> saved_bounds(number_of_columns);
+		if (std::fread(saved_bounds.data(), sizeof(size_t), number_of_columns, file) != number_of_columns)
+			return false;
+
+		std::vector<filtration_entry_t> column;
+		for (size_t index = 0, begin = 0; index < number_of_columns; begin = saved_bounds[index++]) {
+			append_column();
+			if (saved_bounds[index] < begin) return false;
+			column.resize(saved_bounds[index] - begin);
+			if (std::fread(column.data(), sizeof(filtration_entry_t), column.size(), file) != column.size())
+				return false;
+			for (const auto& e : column) push_back(e);
+		}
+		return true;
+	}
+
+	// Removes all columns from the given index on
+	void truncate(size_t number_of_columns) {
+		if (number_of_columns >= size()) return;
+		bounds.resize(number_of_columns);
+		const size_t end = bounds.empty() ? 0 : bounds.back();
+
+		while (blocks.size() > 1 && blocks.back().first_entry >= end) {
+			if (blocks.back().entries.size() == blocks.back().size) resident_blocks--;
+			blocks.pop_back();
+		}
+
+		load_block(blocks.size() - 1);
+		block_t& tail = blocks.back();
+		tail.entries.resize(end - tail.first_entry);
+		tail.size = tail.entries.size();
+		// The copy in the temporary file (if any) is outdated once new entries are added
+		tail.file_offset = -1;
+	}
+
+private:
+	inline size_t column_begin(size_t index) const { return index == 0 ? 0 : bounds[index - 1]; }
+
+	void load_block(size_t b) {
+		block_t& block = blocks[b];
+		block.last_use = ++use_counter;
+		if (block.size == block.entries.size()) return;
+
+		evict_if_necessary(b);
+		block.entries.resize(block.size);
+		if (std::fseek(spill_file, block.file_offset, SEEK_SET) != 0 ||
+		    std::fread(&block.entries[0], sizeof(filtration_entry_t), block.size, spill_file) != block.size) {
+			std::cerr << "Could not read back the reduction matrix from the temporary file." << std::endl;
+			exit(-1);
+		}
+		resident_blocks++;
+	}
+
+	// Removes the least recently used full block from memory, the block `keep` and the block that is
+	// currently written to always stay in memory.
+	void evict_if_necessary(size_t keep) {
+		while (resident_blocks >= max_resident_blocks) {
+			size_t victim = blocks.size();
+			for (size_t b = 0; b + 1 < blocks.size(); b++) {
+				if (b == keep || blocks[b].entries.size() != blocks[b].size || blocks[b].size == 0) continue;
+				if (victim == blocks.size() || blocks[b].last_use < blocks[victim].last_use) victim = b;
+			}
+			if (victim == blocks.size()) return;
+
+			block_t& block = blocks[victim];
+			if (block.file_offset == -1) {
+				if (spill_file == nullptr) spill_file = std::tmpfile();
+				if (spill_file == nullptr || std::fseek(spill_file, 0, SEEK_END) != 0) {
+					std::cerr << "Could not create a temporary file for the reduction matrix." << std::endl;
+					exit(-1);
+				}
+				block.file_offset = std::ftell(spill_file);
+				if (std::fwrite(&block.entries[0], sizeof(filtration_entry_t), block.size, spill_file) != block.size) {
+					std::cerr << "Could not write the reduction matrix to the temporary file." << std::endl;
+					exit(-1);
+				}
+			}
+
+			std::vector<filtration_entry_t> empty;
+			std::swap(block.entries, empty);
+			resident_blocks--;
+		}
+	}
+};
+
+// A max-heap whose storage is kept between uses, so that resetting it does not free any memory
+template <class Comparator>
+class reusable_priority_queue_t : public std::priority_queue<filtration_entry_t, std::vector<filtration_entry_t>, Comparator> {
+public:
+	void reset() { this->c.clear(); }
+};
+
 template <typename Heap> void push_entry(Heap& column, index_t i, coefficient_t c, value_t filtration) {
 	entry_t e = make_entry(i, c);
 	column.push(std::make_pair(filtration, e));
 }
 
+// Open-addressing hash map from cell indices to values that is cleared in constant time: every slot carries
+// the generation in which it was written, and clearing the map just starts a new generation. The memory is
+// kept, so that a map that is cleared for every column does not allocate once it has reached its final size.
+template <typename Value> class reusable_hash_map_t {
+public:
+	reusable_hash_map_t() { rehash(16); }
+
+	size_t size() const { return number_of_entries; }
+
+	void clear() {
+		number_of_entries = 0;
+		if (++generation == 0) {
+			std::fill(generations.begin(), generations.end(), 0);
+			generation = 1;
+		}
+	}
+
+	// Returns a pointer to the value stored for key, or nullptr if there is none
+	inline Value* find(index_t key) {
+		for (size_t position = hash(key);; position = (position + 1) & mask) {
+			if (generations[position] != generation) return nullptr;
+			if (keys[position] == key) return &values[position];
+		}
+	}
+
+	// Note: The key must not be in the map already
+	inline void insert(index_t key, Value value) {
+		if (2 * (number_of_entries + 1) > keys.size()) rehash(2 * keys.size());
+		number_of_entries++;
+		size_t position = hash(key);
+		while (generations[position] == generation) position = (position + 1) & mask;
+		keys[position] = key;
+		values[position] = value;
+		generations[position] = generation;
+	}
+
+	// Removes the key by shifting the following entries of its probe sequence back
+	inline void erase(index_t key) {
+		size_t position = hash(key);
+		while (true) {
+			if (generations[position] != generation) return;
+			if (keys[position] == key) break;
+			position = (position + 1) & mask;
+		}
+		number_of_entries--;
+
+		size_t next = position;
+		while (true) {
+			next = (next + 1) & mask;
+			if (generations[next] != generation) break;
+			const size_t home = hash(keys[next]);
+			const bool stays = position <= next ? (position < home && home <= next) : (position < home || home <= next);
+			if (stays) continue;
+			keys[position] = keys[next];
+			values[position] = values[next];
+			position = next;
+		}
+		generations[position] = generation - 1;
+	}
+
+private:
+	std::vector<index_t> keys;
+	std::vector<Value> values;
+	std::vector<uint32_t> generations;
+	uint32_t generation = 1;
+	size_t number_of_entries = 0;
+	size_t mask = 0;
+	unsigned int shift = 64;
+
+	inline size_t hash(index_t key) const { return (uint64_t(key) * 0x9E3779B97F4A7C15ULL) >> shift; }
+
+	void rehash(size_t capacity) {
+		std::vector<index_t> old_keys(capacity);
+		std::vector<Value> old_values(capacity);
+		std::vector<uint32_t> old_generations(capacity, 0);
+		std::swap(old_keys, keys);
+		std::swap(old_values, values);
+		std::swap(old_generations, generations);
+		const uint32_t old_generation = generation;
+		generation = 1;
+		mask = capacity - 1;
+		shift = 64;
+		while (capacity > 1) {
+			capacity >>= 1;
+			shift--;
+		}
+
+		for (size_t i = 0; i < old_keys.size(); i++) {
+			if (old_generations[i] != old_generation) continue;
+			size_t position = hash(old_keys[i]);
+			while (generations[position] == generation) position = (position + 1) & mask;
+			keys[position] = old_keys[i];
+			values[position] = old_values[i];
+			generations[position] = generation;
+		}
+	}
+};
+
 // This class is just an ordinary priority queue, but once the
 // queue gets too long (because a lot of faces are inserted multiple
 // times) it starts collecting the coefficients and only inserting each
-// new face once
+// new face once. The queue is meant to be kept for all columns and
+// reset in between, so that its memory is reused.
 template <class Container, class Comparator>
 class priority_queue_t : public std::priority_queue<filtration_entry_t, Container, Comparator> {
+	typedef std::priority_queue<filtration_entry_t, Container, Comparator> heap_t;
 #ifdef USE_COEFFICIENTS
-	std::unordered_map<index_t, coefficient_t> coefficients;
+	reusable_hash_map_t<coefficient_t> coefficients;
 #else
-	std::unordered_map<index_t, bool> coefficients;
+	// Note: Not bool, because std::vector<bool> does not allow pointers to its elements
+	reusable_hash_map_t<uint8_t> coefficients;
 #endif
 	static const filtration_entry_t dummy;
 	// TODO: Enable dynamic switching to the dense version for coefficients
@@ -268,28 +749,36 @@ public:
 	priority_queue_t(coefficient_t _modulus, size_t _dense_threshold)
 	    : modulus(_modulus), dense_threshold(_dense_threshold) {}
 
+	// Empties the queue but keeps the allocated memory
+	void reset(size_t _dense_threshold) {
+		this->c.clear();
+		coefficients.clear();
+#ifndef USE_COEFFICIENTS
+		use_dense_version = false;
+#endif
+		dense_threshold = _dense_threshold;
+	}
+
 	void push(const filtration_entry_t& value) {
 		if (use_dense_version) {
 			// If we already have this value: update the count and don't push it again
 			auto p = coefficients.find(get_index(value));
-			if (p != coefficients.end()) {
+			if (p != nullptr) {
 #ifdef USE_COEFFICIENTS
-				p->second = (p->second + get_coefficient(value)) % modulus;
+				*p = (*p + get_coefficient(value)) % modulus;
 #else
-				p->second = !p->second;
+				*p = !*p;
 #endif
 				return;
 			}
 		}
 
-		std::priority_queue<filtration_entry_t, Container, Comparator>::push(value);
+		heap_t::push(value);
 
-		if (use_dense_version) coefficients.insert(std::make_pair(get_index(value), get_coefficient(value)));
+		if (use_dense_version) coefficients.insert(get_index(value), get_coefficient(value));
 
 #ifndef USE_COEFFICIENTS
-		if (!use_dense_version &&
-		    std::priority_queue<filtration_entry_t, Container, Comparator>::size() >= dense_threshold)
-			use_dense_version = true;
+		if (!use_dense_version && heap_t::size() >= dense_threshold) use_dense_version = true;
 #endif
 	}
 
@@ -300,7 +789,7 @@ public:
 
 	filtration_entry_t pop_pivot() {
 		remove_trivial_coefficient_entries();
-		if (std::priority_queue<filtration_entry_t, Container, Comparator>::empty())
+		if (heap_t::empty())
 			return dummy;
 		else {
 			auto pivot = get_top();
@@ -313,23 +802,20 @@ public:
 				remove_trivial_coefficient_entries();
 
 				if (coefficient == 0) {
-					if (std::priority_queue<filtration_entry_t, Container, Comparator>::empty())
+					if (heap_t::empty())
 						return dummy;
 					else
 						pivot = get_top();
 				}
-			} while (!std::priority_queue<filtration_entry_t, Container, Comparator>::empty() &&
-			         get_index(get_top()) == get_index(pivot));
+			} while (!heap_t::empty() && get_index(get_top()) == get_index(pivot));
 			if (get_index(pivot) != -1) { set_coefficient(pivot, coefficient); }
 #else
 			safe_pop();
-			while (!std::priority_queue<filtration_entry_t, Container, Comparator>::empty() &&
-			       get_index(std::priority_queue<filtration_entry_t, Container, Comparator>::top()) ==
-			           get_index(pivot)) {
+			while (!heap_t::empty() && get_index(heap_t::top()) == get_index(pivot)) {
 				safe_pop();
 				remove_trivial_coefficient_entries();
 
-				if (std::priority_queue<filtration_entry_t, Container, Comparator>::empty())
+				if (heap_t::empty())
 					return dummy;
 				else {
 					pivot = get_top();
@@ -349,12 +835,12 @@ public:
 
 private:
 	inline filtration_entry_t get_top() {
-		auto pivot = std::priority_queue<filtration_entry_t, Container, Comparator>::top();
+		auto pivot = heap_t::top();
 
 #ifdef USE_COEFFICIENTS
 		if (use_dense_version) {
 			auto e = coefficients.find(get_index(pivot));
-			if (e != coefficients.end()) set_coefficient(pivot, e->second);
+			if (e != nullptr) set_coefficient(pivot, *e);
 		}
 #endif
 
@@ -362,26 +848,22 @@ private:
 	}
 
 	inline void safe_pop() {
-		if (use_dense_version) {
-			auto e =
-			    coefficients.find(get_index(std::priority_queue<filtration_entry_t, Container, Comparator>::top()));
-			if (e != coefficients.end()) coefficients.erase(e);
-		}
-		std::priority_queue<filtration_entry_t, Container, Comparator>::pop();
+		if (use_dense_version) coefficients.erase(get_index(heap_t::top()));
+		heap_t::pop();
 	}
 
 	inline void remove_trivial_coefficient_entries() {
 		if (use_dense_version) {
-			auto p =
-			    coefficients.find(get_index(std::priority_queue<filtration_entry_t, Container, Comparator>::top()));
+			while (!heap_t::empty()) {
+				const index_t index = get_index(heap_t::top());
+				auto p = coefficients.find(index);
 #ifdef USE_COEFFICIENTS
-			while (p != coefficients.end() && p->second % modulus == 0) {
+				if (p == nullptr || *p % modulus != 0) break;
 #else
-			while (p != coefficients.end() && p->second == false) {
+				if (p == nullptr || *p != 0) break;
 #endif
-				coefficients.erase(p);
-				std::priority_queue<filtration_entry_t, Container, Comparator>::pop();
-				p = coefficients.find(get_index(std::priority_queue<filtration_entry_t, Container, Comparator>::top()));
+				coefficients.erase(index);
+				heap_t::pop();
 			}
 		}
 	}
@@ -444,6 +926,236 @@ private:
 };
 #endif
 
+// The outcome of reducing a single column, used to undo and retry the reduction in the adaptive approximation
+struct column_result_t {
+	enum kind_t : uint8_t { PAIRED, ESSENTIAL, SKIPPED };
+	kind_t kind;
+	value_t death;
+	index_t pivot;
+	index_t entries;
+	float seconds;
+};
+
+// Histogram of the effort it took to reduce the columns of one dimension. The columns are grouped by the
+// number of entries that were added to the working coboundary, bucket b contains the columns with less than
+// 2^b (and at least 2^(b-1)) entries.
+struct reduction_statistics_t {
+	std::vector<size_t> resolved_columns;
+	std::vector<double> resolved_seconds;
+	size_t skipped_columns = 0;
+	double skipped_seconds = 0;
+	size_t retries = 0;
+	size_t final_budget = 0;
+
+	void add(size_t entries, double seconds, bool skipped) {
+		if (skipped) {
+			skipped_columns++;
+			skipped_seconds += seconds;
+			return;
+		}
+
+		size_t bucket = 0;
+		while (bucket < 64 && (size_t(1) << bucket) <= entries) bucket++;
+		if (bucket >= resolved_columns.size()) {
+			resolved_columns.resize(bucket + 1, 0);
+			resolved_seconds.resize(bucket + 1, 0);
+		}
+		resolved_columns[bucket]++;
+		resolved_seconds[bucket] += seconds;
+	}
+
+	void print(std::ostream& stream) const {
+		size_t resolved = 0;
+		for (auto c : resolved_columns) resolved += c;
+
+		stream << "# Resolved " << resolved << " columns, skipped " << skipped_columns;
+		if (retries > 0) stream << " after " << retries << " retries (final budget " << final_budget << " entries)";
+		stream << std::endl;
+		for (size_t bucket = 0; bucket < resolved_columns.size(); bucket++) {
+			if (resolved_columns[bucket] == 0) continue;
+			stream << "#   ";
+			if (bucket == 0)
+				stream << "no entries";
+			else
+				stream << "< " << (size_t(1) << bucket) << " entries";
+			stream << ": " << resolved_columns[bucket] << " columns (" << resolved_seconds[bucket] << "s)" << std::endl;
+		}
+		if (skipped_columns > 0)
+			stream << "#   skipped: " << skipped_columns << " columns (" << skipped_seconds << "s)" << std::endl;
+	}
+};
+
+// Everything the persistence computer reports to its output, so that it can be replayed after resuming from a
+// checkpoint. Dimensions and Betti numbers are stored in number and skipped.
+struct output_event_t {
+	enum kind_t : uint32_t { DIMENSION, BARCODE, INFINITE_BARCODE, SKIPPED_COLUMN, BETTI_NUMBER, TRIVIAL_REMAINDER };
+	kind_t kind;
+	value_t birth;
+	value_t death;
+	uint64_t number;
+	uint64_t skipped;
+};
+
+// Passes everything on to the wrapped output and appends the events of the computation to a log file, a checkpoint
+// only stores the number of events that belong to it
+template <typename Complex> class recording_output_t : public output_t<Complex> {
+	output_t<Complex>* output;
+	std::FILE* log = nullptr;
+	uint64_t number_of_events = 0;
+
+public:
+	recording_output_t(output_t<Complex>* _output) : output(_output) {}
+	~recording_output_t() {
+		if (log != nullptr) std::fclose(log);
+	}
+
+	// Starts an empty log
+	bool start(const std::string& filename) {
+		log = std::fopen(filename.c_str(), "wb");
+		number_of_events = 0;
+		return log != nullptr;
+	}
+
+	// Continues the log after its first events (those of a checkpoint) and reads them, the events recorded after
+	// them are discarded
+	bool resume(const std::string& filename, uint64_t _number_of_events, std::vector<output_event_t>& events) {
+		log = std::fopen(filename.c_str(), "r+b");
+		if (log == nullptr) return false;
+		events.resize(_number_of_events);
+		number_of_events = _number_of_events;
+		return std::fread(events.data(), sizeof(output_event_t), events.size(), log) == events.size() &&
+		       ftruncate(fileno(log), number_of_events * sizeof(output_event_t)) == 0 &&
+		       std::fseek(log, 0, SEEK_END) == 0;
+	}
+
+	// Makes sure that all events recorded so far are on the disk, returns their number (or -1 if that failed)
+	int64_t sync() {
+		if (log == nullptr || std::fflush(log) != 0 || std::ferror(log) || fsync(fileno(log)) != 0) return -1;
+		return number_of_events;
+	}
+
+	void set_complex(Complex* complex) override { output->set_complex(complex); }
+	void print(std::string s) override { output->print(s); }
+	void finished(bool with_cell_counts) override { output->finished(with_cell_counts); }
+	void print_aggregated_results() override { output->print_aggregated_results(); }
+	void add_results_of(output_t<Complex>* other) override { output->add_results_of(other); }
+
+	void computing_barcodes_in_dimension(unsigned int dimension) override {
+		record(output_event_t::DIMENSION, 0, 0, dimension);
+		output->computing_barcodes_in_dimension(dimension);
+	}
+	void new_barcode(value_t birth, value_t death) override {
+		record(output_event_t::BARCODE, birth, death);
+		output->new_barcode(birth, death);
+	}
+	void new_infinite_barcode(value_t birth) override {
+		record(output_event_t::INFINITE_BARCODE, birth);
+		output->new_infinite_barcode(birth);
+	}
+	void skipped_column(value_t birth) override {
+		record(output_event_t::SKIPPED_COLUMN, birth);
+		output->skipped_column(birth);
+	}
+	void betti_number(size_t betti, size_t skipped) override {
+		record(output_event_t::BETTI_NUMBER, 0, 0, betti, skipped);
+		output->betti_number(betti, skipped);
+	}
+	void remaining_homology_is_trivial() override {
+		record(output_event_t::TRIVIAL_REMAINDER);
+		output->remaining_homology_is_trivial();
+	}
+
+	// Passes the events on to the output without recording them again
+	void replay(const std::vector<output_event_t>& events) {
+		for (const auto& e : events) {
+			switch (e.kind) {
+			case output_event_t::DIMENSION: output->computing_barcodes_in_dimension(e.number); break;
+			case output_event_t::BARCODE: output->new_barcode(e.birth, e.death); break;
+			case output_event_t::INFINITE_BARCODE: output->new_infinite_barcode(e.birth); break;
+			case output_event_t::SKIPPED_COLUMN: output->skipped_column(e.birth); break;
+			case output_event_t::BETTI_NUMBER: output->betti_number(e.number, e.skipped); break;
+			case output_event_t::TRIVIAL_REMAINDER: output->remaining_homology_is_trivial(); break;
+			}
+		}
+	}
+
+private:
+	void record(output_event_t::kind_t kind, value_t birth = 0, value_t death = 0, uint64_t number = 0,
+	            uint64_t skipped = 0) {
+		output_event_t e;
+		memset(&e, 0, sizeof(e));
+		e.kind = kind;
+		e.birth = birth;
+		e.death = death;
+		e.number = number;
+		e.skipped = skipped;
+		if (log != nullptr) std::fwrite(&e, sizeof(e), 1, log);
+		number_of_events++;
+	}
+};
+
+// The run a cache or checkpoint was written by: the filtration, the modulus and the input graph, which is
+// identified by its number of vertices and edges and a hash of the edges and filtration values that does not
+// depend on the order of the edges (see coboundary_cache_key)
+struct coboundary_cache_key_t {
+	char filtration[32];
+	uint32_t modulus;
+	uint64_t vertices;
+	uint64_t edges;
+	uint64_t graph_hash;
+};
+
+// A checkpoint of the reduction consists of this header, the columns to reduce, the pivots found so far (as pairs
+// of pivot and column) and the reduction matrix of the current dimension. The output events are kept in a separate
+// log that only grows, the checkpoint contains its first number_of_events events.
+const char CHECKPOINT_MAGIC[8] = {'F', 'L', 'A', 'G', 'S', 'E', 'R', 'P'};
+const uint32_t CHECKPOINT_VERSION = 3;
+
+struct checkpoint_header_t {
+	char magic[8];
+	uint32_t version;
+	uint32_t entry_size;
+	uint32_t modulus;
+	uint32_t min_dimension;
+	uint32_t max_dimension;
+	uint32_t dimension;
+	coboundary_cache_key_t key;
+	uint64_t max_entries;
+	uint64_t number_of_cells;
+	uint64_t number_of_next_cells;
+	uint64_t next_column;
+	uint64_t number_of_events;
+	int64_t betti;
+	int64_t betti_error;
+	int64_t euler_characteristic;
+	double pivot_density;
+};
+
+template <typename T> bool write_vector(std::FILE* file, const T* data, size_t size) {
+	const uint64_t n = size;
+	return std::fwrite(&n, sizeof(uint64_t), 1, file) == 1 && std::fwrite(data, sizeof(T), size, file) == size;
+}
+
+template <typename T> bool read_vector(std::FILE* file, std::vector<T>& data) {
+	uint64_t n;
+	if (std::fread(&n, sizeof(uint64_t), 1, file) != 1) return false;
+	data.resize(n);
+	return std::fread(data.data(), sizeof(T), n, file) == n;
+}
+
+bool write_reduction_columns(std::FILE* file, reduction_matrix_t* reduction) { return reduction->write_columns(file); }
+bool read_reduction_columns(std::FILE* file, reduction_matrix_t* reduction) { return reduction->read_columns(file); }
+bool write_reduction_columns(std::FILE* file, std::vector<filtration_entry_t>* reduction) {
+	return write_vector(file, reduction->data(), reduction->size());
+}
+bool read_reduction_columns(std::FILE* file, std::vector<filtration_entry_t>* reduction) {
+	return read_vector(file, *reduction);
+}
+bool write_reduction_columns(std::FILE*, std::nullptr_t) { return true; }
+bool read_reduction_columns(std::FILE*, std::nullptr_t) { return true; }
+
+// The complex has to allow calls of coboundary() from several threads at once if apparent pairs are used (see
+// set_apparent_pairs), the coboundaries are only read in that case.
 template <typename Complex> class persistence_computer_t {
 private:
 	Complex& complex;
@@ -452,6 +1164,30 @@ private:
 	size_t max_entries;
 	index_t euler_characteristic = 0;
 	bool print_betti_numbers_to_console = true;
+	// Where the Betti numbers are printed to
+	std::ostream* console = &std::cout;
+	// The fraction of cells that were pivots in the previous dimension, negative if unknown
+	double pivot_density = -1;
+	size_t max_resident_reduction_entries = std::numeric_limits<size_t>::max();
+	bool use_apparent_pairs = true;
+	// If set, skipped columns are retried with larger budgets until the deadline has passed
+	bool retry_skipped_columns = false;
+	std::chrono::steady_clock::time_point deadline;
+	reduction_statistics_t statistics;
+
+	// If a checkpoint directory is set, the state of the reduction is saved there regularly
+	std::string checkpoint_directory;
+	std::chrono::steady_clock::duration checkpoint_interval;
+	std::chrono::steady_clock::time_point next_checkpoint;
+	bool resume_from_checkpoint = false;
+	// The filtration and graph of this run, a checkpoint of another run is rejected
+	coboundary_cache_key_t checkpoint_key;
+	unsigned int current_min_dimension = 0;
+	unsigned int current_max_dimension = 0;
+	std::shared_ptr<recording_output_t<Complex>> recorder;
+	// The checkpoint the computation resumes from, the file is positioned at the pivots
+	checkpoint_header_t resumed;
+	std::FILE* resume_file = nullptr;
 
 #ifdef USE_COEFFICIENTS
 	coefficient_t modulus = 2;
@@ -478,13 +1214,55 @@ public:
 	}
 
 	void set_print_betti_numbers(bool print_betti_numbers) { print_betti_numbers_to_console = print_betti_numbers; }
+	void set_console(std::ostream& _console) { console = &_console; }
+
+	// Limits the memory used for the reduction matrix, the rest is moved to a temporary file
+	void set_reduction_matrix_memory(size_t bytes) {
+		max_resident_reduction_entries = bytes / sizeof(filtration_entry_t);
+	}
+
+	// Finding the apparent pairs takes two extra passes over the coboundaries of all columns of every dimension,
+	// which is wasted if only few columns form apparent pairs. The passes run in parallel, so the complex has to
+	// allow concurrent calls of coboundary().
+	void set_apparent_pairs(bool _use_apparent_pairs) { use_apparent_pairs = _use_apparent_pairs; }
+
+	// Saves the state of the reduction into the directory every interval, if resume is set the computation
+	// starts from the checkpoint in the directory (if there is one). All results are reported to the output
+	// again, so the output has to start empty. The key identifies the filtration and the graph, it has to be
+	// computed before the complex changes the filtration values of the graph.
+	void set_checkpoints(const std::string& directory, double interval_seconds, bool resume,
+	                     const coboundary_cache_key_t& key) {
+		checkpoint_directory = directory;
+		checkpoint_key = key;
+		checkpoint_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		    std::chrono::duration<double>(interval_seconds));
+		next_checkpoint = std::chrono::steady_clock::now() + checkpoint_interval;
+		resume_from_checkpoint = resume;
+		recorder = std::make_shared<recording_output_t<Complex>>(output);
+		output = recorder.get();
+		if (!resume) start_event_log();
+	}
+
+	// Only has an effect together with max_entries: after a dimension is reduced, the reduction is undone
+	// from the first skipped column on and repeated with four times the budget, as long as time is left
+	void set_deadline(std::chrono::steady_clock::time_point _deadline) {
+		retry_skipped_columns = max_entries < std::numeric_limits<size_t>::max();
+		deadline = _deadline;
+	}
 
 	void compute_persistence(unsigned int min_dimension = 0,
 	                         unsigned int max_dimension = std::numeric_limits<unsigned int>::max(), bool check_euler_characteristic = true) {
+		current_min_dimension = min_dimension;
+		current_max_dimension = max_dimension;
+		if (resume_from_checkpoint) read_checkpoint(min_dimension, max_dimension);
 		compute_zeroth_persistence(min_dimension, max_dimension);
 		compute_higher_persistence(min_dimension, max_dimension);
 		complex.finished();
 		output->finished(check_euler_characteristic);
+		if (!checkpoint_directory.empty()) {
+			std::remove(checkpoint_filename().c_str());
+			std::remove(event_log_filename().c_str());
+		}
 
 		// Sanity check whether there were any problems computing the homology
 		bool computed_full_homology = min_dimension == 0 && max_dimension == std::numeric_limits<unsigned int>::max();
@@ -498,7 +1276,7 @@ public:
 			}
 
 			if (print_betti_numbers_to_console)
-				std::cout << "The Euler characteristic is given by: " << cell_euler_characteristic << std::endl;
+				*console << "The Euler characteristic is given by: " << cell_euler_characteristic << std::endl;
 
 			if (cell_euler_characteristic != euler_characteristic) {
 				std::cerr << "ERROR: The homological Euler characteristic (which is " << euler_characteristic
@@ -531,7 +1309,7 @@ protected:
 		complex.prepare_next_dimension(0);
 
 		// Only compute this if we actually need it
-		if (min_dimension > 1) return;
+		if (min_dimension > 1 || resume_file != nullptr) return;
 
 #ifdef INDICATE_PROGRESS
 		std::cout << "\033[K"
@@ -611,17 +1389,24 @@ protected:
 		output->betti_number(betti_number, 0);
 
 		if (print_betti_numbers_to_console) {
-			std::cout << "\033[K"
-			          << "The dimensions of the mod-" << modulus << " homology of the full complex are:" << std::endl
-			          << std::endl
-			          << "dim H_0 = " << betti_number << std::endl;
+			std::cout << "\033[K";
+			*console << "The dimensions of the mod-" << modulus << " homology of the full complex are:" << std::endl
+			         << std::endl
+			         << "dim H_0 = " << betti_number << std::endl;
 		}
 		euler_characteristic += betti_number;
 	}
 
 	void compute_higher_persistence(unsigned int min_dimension, unsigned int max_dimension) {
 		for (index_t dimension = 1; dimension <= max_dimension; ++dimension) {
-			if (dimension + 1 == min_dimension) {
+			// The dimensions before the one of the checkpoint are already done
+			const bool resuming = resume_file != nullptr;
+			if (resuming && dimension < resumed.dimension) {
+				complex.prepare_next_dimension(dimension);
+				continue;
+			}
+
+			if (dimension + 1 == min_dimension && !resuming) {
 				// Here we need to reduce *all* cells because we did not compute anything of smaller dimension
 				// Also, we do not care about the filtration, so we can just set it to be trivial
 				index_t number_of_cells = complex.number_of_cells(dimension);
@@ -634,22 +1419,24 @@ protected:
 
 			if (dimension + 1 < min_dimension) continue;
 
-			output->computing_barcodes_in_dimension(dimension);
-
-			sort_columns();
+			if (!resuming) {
+				output->computing_barcodes_in_dimension(dimension);
+				sort_columns();
+			}
 
 #ifdef INDICATE_PROGRESS
 			std::cout << "\033[K"
 			          << "computing persistent homology in dimension " << dimension << std::flush << "\r";
 #endif
-#ifdef USE_ARRAY_HASHMAP
-			pivot_column_index_t pivot_column_index(complex.number_of_cells(dimension + 1), INVALID_INDEX);
-#else
-			pivot_column_index_t pivot_column_index;
-			pivot_column_index.reserve(complex.number_of_cells(dimension + 1));
-#endif
+			// Guess the number of pivots from the previous dimension, at most every column has a pivot
+			const size_t number_of_next_cells = complex.number_of_cells(dimension + 1);
+			size_t expected_number_of_pivots = columns_to_reduce.size();
+			if (pivot_density >= 0) expected_number_of_pivots = size_t(pivot_density * number_of_next_cells) + 1;
+			pivot_column_index_t pivot_column_index(number_of_next_cells, columns_to_reduce.size(),
+			                                        expected_number_of_pivots);
 
 			auto betti = compute_pairs(dimension, pivot_column_index, dimension >= min_dimension);
+			pivot_density = number_of_next_cells > 0 ? double(pivot_column_index.size()) / number_of_next_cells : 0;
 			if (dimension >= min_dimension) {
 				complex.computation_result(dimension, betti.first, betti.second);
 #ifdef RETRIEVE_PERSISTENCE
@@ -659,15 +1446,16 @@ protected:
 				euler_characteristic += (dimension & 1 ? -1 : 1) * betti.first;
 
 				if (print_betti_numbers_to_console) {
-					std::cout << "\033[K"
-					          << "dim H_" << dimension << " = " << betti.first;
-					if (betti.second > 0) { std::cout << " (skipped " << betti.second << ")"; }
-					std::cout << std::endl;
+					std::cout << "\033[K";
+					*console << "dim H_" << dimension << " = " << betti.first;
+					if (betti.second > 0) { *console << " (skipped " << betti.second << ")"; }
+					*console << std::endl;
+					if (retry_skipped_columns) statistics.print(*console);
 				}
 			} else if (dimension == min_dimension - 1 && print_betti_numbers_to_console &&
 			           max_entries < std::numeric_limits<size_t>::max()) {
-				std::cout << "\033[K"
-				          << "# Skipped columns in dimension " << dimension << ": " << betti.second << std::endl;
+				std::cout << "\033[K";
+				*console << "# Skipped columns in dimension " << dimension << ": " << betti.second << std::endl;
 			}
 			if (dimension < max_dimension) assemble_columns_to_reduce(dimension, pivot_column_index);
 
@@ -690,13 +1478,7 @@ protected:
 #endif
 
 		for (index_t index = 0; index < num_cells; ++index) {
-			if (
-#ifdef USE_ARRAY_HASHMAP
-			    pivot_column_index[index] == INVALID_INDEX
-#else
-			    pivot_column_index.find(index) == pivot_column_index.end()
-#endif
-			) {
+			if (!pivot_column_index.contains(index)) {
 				value_t filtration = complex.filtration(dimension + 1, index);
 				if (filtration <= max_filtration) { columns_to_reduce.push_back(std::make_pair(filtration, index)); }
 #ifdef INDICATE_PROGRESS
@@ -731,14 +1513,94 @@ protected:
 #endif
 	}
 
+#ifndef SKIP_APPARENT_PAIRS
+	// Runs f(thread_index, column_index) for all columns to reduce, distributed over PARALLEL_THREADS threads
+	template <typename Func> void for_each_column_in_parallel(Func f) {
+		if (compute_serially() || columns_to_reduce.size() < MINIMAL_COLUMNS_FOR_THREADS) {
+			for (int t = 0; t < PARALLEL_THREADS; ++t)
+				for (size_t index = t; index < columns_to_reduce.size(); index += PARALLEL_THREADS) f(t, index);
+			return;
+		}
+
+		std::vector<std::thread> threads;
+		for (int t = 0; t < PARALLEL_THREADS; ++t) {
+			threads.push_back(std::thread([this, &f, t]() {
+				for (size_t index = t; index < columns_to_reduce.size(); index += PARALLEL_THREADS) f(t, index);
+			}));
+		}
+		for (auto& thread : threads) thread.join();
+	}
+
+	// The pivot of the column of the boundary matrix belonging to the given cell
+	filtration_entry_t unreduced_pivot(const filtration_index_t& cell) {
+		greater_filtration_or_smaller_index<filtration_entry_t> comparator;
+		filtration_entry_t pivot(-1);
+		auto coboundary = complex.coboundary(filtration_entry_t(cell, 1));
+		while (coboundary.has_next()) {
+			filtration_entry_t coface = coboundary.next();
+			if (get_filtration(coface) <= max_filtration && (get_index(pivot) == -1 || comparator(pivot, coface)))
+				pivot = coface;
+		}
+		return pivot;
+	}
+
+	// Finds the apparent pairs: a column whose pivot does not appear in any earlier column is already
+	// reduced, because no earlier column can end up with the same pivot. Returns the pivot of every such
+	// column and an entry with index -1 for all other columns.
+	std::vector<filtration_entry_t> find_apparent_pairs(index_t dimension) {
+#ifdef INDICATE_PROGRESS
+		std::cout << "\033[K"
+		          << "finding apparent pairs among " << columns_to_reduce.size() << " columns" << std::flush << "\r";
+#endif
+
+		std::vector<filtration_entry_t> pivots(columns_to_reduce.size(), filtration_entry_t(-1));
+		for_each_column_in_parallel(
+		    [this, &pivots](int, size_t index) { pivots[index] = unreduced_pivot(columns_to_reduce[index]); });
+
+		// Only the first column with a given pivot can form an apparent pair
+		pivot_column_index_t first_column(complex.number_of_cells(dimension + 1), columns_to_reduce.size(),
+		                                  columns_to_reduce.size());
+		for (size_t index = 0; index < pivots.size(); ++index) {
+			if (get_index(pivots[index]) == -1) continue;
+			if (first_column.contains(get_index(pivots[index])))
+				pivots[index] = filtration_entry_t(-1);
+			else
+				first_column.insert(get_index(pivots[index]), index);
+		}
+
+		// A column is not apparent if its pivot appears in any earlier column
+		std::array<std::vector<index_t>, PARALLEL_THREADS> not_apparent;
+		for_each_column_in_parallel([this, &first_column, &not_apparent](int thread, size_t index) {
+			auto coboundary = complex.coboundary(filtration_entry_t(columns_to_reduce[index], 1));
+			while (coboundary.has_next()) {
+				filtration_entry_t coface = coboundary.next();
+				if (get_filtration(coface) > max_filtration) continue;
+				index_t column = first_column.find(get_index(coface));
+				if (column != INVALID_INDEX && size_t(column) > index) not_apparent[thread].push_back(column);
+			}
+		});
+		for (auto& columns : not_apparent)
+			for (auto column : columns) pivots[column] = filtration_entry_t(-1);
+
+#ifdef INDICATE_PROGRESS
+		std::cout << "\033[K";
+#endif
+		return pivots;
+	}
+#endif
+
 	std::pair<index_t, index_t> compute_pairs(index_t dimension, pivot_column_index_t& pivot_column_index,
 	                                          bool generate_output = true) {
 		index_t betti = 0;
 		index_t betti_error = 0;
 		index_t verbose_logging_threshold = (index_t)columns_to_reduce.size() * 0.90;
 
+		priority_queue_t<std::vector<filtration_entry_t>, greater_filtration_or_smaller_index<filtration_entry_t>>
+		    working_coboundary(modulus, columns_to_reduce.size());
+
 #ifdef ASSEMBLE_REDUCTION_MATRIX
-		compressed_sparse_matrix<filtration_entry_t> reduction_coefficients;
+		reduction_matrix_t reduction_coefficients(max_resident_reduction_entries);
+		reusable_priority_queue_t<smaller_index<filtration_entry_t>> reduction_column;
 #else
 #ifdef USE_COEFFICIENTS
 		std::vector<filtration_entry_t> reduction_coefficients;
@@ -748,188 +1610,279 @@ protected:
 		std::vector<std::pair<value_t, value_t>> birth_death;
 #endif
 
+#ifndef SKIP_APPARENT_PAIRS
 		std::vector<filtration_entry_t> coface_entries;
+		greater_filtration_or_smaller_index<filtration_entry_t> pivot_comparator;
+		const std::vector<filtration_entry_t> apparent_pivots =
+		    use_apparent_pairs ? find_apparent_pairs(dimension) : std::vector<filtration_entry_t>();
+#endif
+
+		statistics = reduction_statistics_t();
+		const bool record_statistics = retry_skipped_columns;
+		size_t budget = max_entries;
+		std::vector<column_result_t> results;
+
+#if defined(ASSEMBLE_REDUCTION_MATRIX) || defined(USE_COEFFICIENTS)
+		auto reduction_state = &reduction_coefficients;
+#else
+		std::nullptr_t reduction_state = nullptr;
+#endif
+		index_t first_column = 0;
+		if (resume_file != nullptr)
+			first_column = resume_reduction(dimension, pivot_column_index, reduction_state, betti, betti_error);
+
+		auto report_column = [&](value_t filtration, const column_result_t& result) {
+			if (record_statistics) statistics.add(result.entries, result.seconds, result.kind == column_result_t::SKIPPED);
 
-		for (index_t i = 0; i < columns_to_reduce.size(); ++i) {
-			auto column_to_reduce = columns_to_reduce[i];
+			if (result.kind == column_result_t::SKIPPED) {
+				if (generate_output) output->skipped_column(filtration);
+#ifdef RETRIEVE_PERSISTENCE
+				birth_death.push_back(std::make_pair(filtration, std::numeric_limits<value_t>::signaling_NaN()));
+#endif
+				betti_error++;
+			} else if (result.kind == column_result_t::ESSENTIAL) {
+				if (generate_output) {
+					output->new_infinite_barcode(filtration);
+					betti++;
+#ifdef RETRIEVE_PERSISTENCE
+					birth_death.push_back(std::make_pair(filtration, std::numeric_limits<value_t>::infinity()));
+#endif
+				}
+			} else if (generate_output && filtration != result.death) {
+				output->new_barcode(filtration, result.death);
+#ifdef RETRIEVE_PERSISTENCE
+				birth_death.push_back(std::make_pair(filtration, result.death));
+#endif
+			}
+		};
+
+		while (true) {
+			index_t first_skipped_column = columns_to_reduce.size();
+
+			for (index_t i = first_column; i < columns_to_reduce.size(); ++i) {
+				auto column_to_reduce = columns_to_reduce[i];
+
+				if (!checkpoint_directory.empty() && !retry_skipped_columns && i % 16 == 0 &&
+				    std::chrono::steady_clock::now() >= next_checkpoint)
+					write_checkpoint(dimension, i, pivot_column_index, reduction_state, betti, betti_error);
 
 #ifdef ASSEMBLE_REDUCTION_MATRIX
-			std::priority_queue<filtration_entry_t, std::deque<filtration_entry_t>, smaller_index<filtration_entry_t>>
-			    reduction_column;
+				reduction_column.reset();
 #endif
 
-			priority_queue_t<std::deque<filtration_entry_t>, greater_filtration_or_smaller_index<filtration_entry_t>>
-			    working_coboundary(modulus, columns_to_reduce.size());
+				working_coboundary.reset(columns_to_reduce.size());
 
-			value_t filtration = get_filtration(column_to_reduce);
+				value_t filtration = get_filtration(column_to_reduce);
+				column_result_t result;
+				std::chrono::steady_clock::time_point column_start;
+				if (record_statistics) column_start = std::chrono::steady_clock::now();
 
 #ifdef INDICATE_PROGRESS
-			if ((i + 1) % 10000 == 0 || (i >= verbose_logging_threshold && (i + 1) % 1000 == 0)) {
-				std::cout << "\033[K"
-				          << "reducing column " << i + 1 << "/" << columns_to_reduce.size() << " (filtration "
-				          << filtration << ", infinite bars: " << betti;
-				if (betti_error > 0) std::cout << " (skipped " << betti_error << ")";
-				std::cout << ")" << std::flush << "\r";
-			}
+				if ((i + 1) % 10000 == 0 || (i >= verbose_logging_threshold && (i + 1) % 1000 == 0)) {
+					std::cout << "\033[K"
+					          << "reducing column " << i + 1 << "/" << columns_to_reduce.size() << " (filtration "
+					          << filtration << ", infinite bars: " << betti;
+					if (betti_error > 0) std::cout << " (skipped " << betti_error << ")";
+					if (statistics.retries > 0) std::cout << ", retry " << statistics.retries;
+					std::cout << ")" << std::flush << "\r";
+				}
 #endif
 
-			index_t j = i;
+				index_t j = i;
 
-			// start with a dummy pivot entry with coefficient -1 in order to initialize
-			// working_coboundary with the coboundary of the simplex with index column_to_reduce
-			filtration_entry_t pivot(0, -1, -1 + modulus);
+				// start with a dummy pivot entry with coefficient -1 in order to initialize
+				// working_coboundary with the coboundary of the simplex with index column_to_reduce
+				filtration_entry_t pivot(0, -1, -1 + modulus);
 
 #ifdef ASSEMBLE_REDUCTION_MATRIX
-			// initialize reduction_coefficients as identity matrix
-			reduction_coefficients.append_column();
-			reduction_coefficients.push_back(filtration_entry_t(column_to_reduce, 1));
+				// initialize reduction_coefficients as identity matrix (which is stored as an empty column)
+				reduction_coefficients.append_column();
 #else
 #ifdef USE_COEFFICIENTS
-			reduction_coefficients.push_back(filtration_entry_t(column_to_reduce, 1));
+				reduction_coefficients.push_back(filtration_entry_t(column_to_reduce, 1));
 #endif
 #endif
 
-			bool might_be_apparent_pair = (i == j);
+#ifndef SKIP_APPARENT_PAIRS
+				bool might_be_apparent_pair = true;
+#endif
 
-			index_t iterations = 0;
-			do {
-				const coefficient_t factor = modulus - get_coefficient(pivot);
+				index_t iterations = 0;
+				do {
+					const coefficient_t factor = modulus - get_coefficient(pivot);
 
 #ifdef ASSEMBLE_REDUCTION_MATRIX
-				auto coeffs_begin = reduction_coefficients.cbegin(j), coeffs_end = reduction_coefficients.cend(j);
+					filtration_entry_t trivial_column;
+					const filtration_entry_t* coeffs_begin = &trivial_column;
+					const filtration_entry_t* coeffs_end = &trivial_column + 1;
+					if (reduction_coefficients.is_trivial(j))
+						trivial_column = filtration_entry_t(columns_to_reduce[j], 1);
+					else
+						std::tie(coeffs_begin, coeffs_end) = reduction_coefficients.column(j);
 #else
 #ifdef USE_COEFFICIENTS
-				auto coeffs_begin = &reduction_coefficients[j], coeffs_end = &reduction_coefficients[j] + 1;
+					auto coeffs_begin = &reduction_coefficients[j], coeffs_end = &reduction_coefficients[j] + 1;
 #else
-				auto coeffs_begin = &columns_to_reduce[j], coeffs_end = &columns_to_reduce[j] + 1;
+					auto coeffs_begin = &columns_to_reduce[j], coeffs_end = &columns_to_reduce[j] + 1;
 #endif
 #endif
-				for (auto it = coeffs_begin; it != coeffs_end; ++it) {
-					filtration_entry_t cell = *it;
-					set_coefficient(cell, get_coefficient(cell) * factor % modulus);
+					for (auto it = coeffs_begin; it != coeffs_end; ++it) {
+						filtration_entry_t cell = *it;
+						set_coefficient(cell, get_coefficient(cell) * factor % modulus);
 
 #ifdef ASSEMBLE_REDUCTION_MATRIX
-					reduction_column.push(cell);
+						reduction_column.push(cell);
 #endif
-					coface_entries.clear();
 
-					auto coboundary = complex.coboundary(cell);
+#ifndef SKIP_APPARENT_PAIRS
+						if (might_be_apparent_pair && use_apparent_pairs && get_index(apparent_pivots[i]) != -1) {
+							pivot = apparent_pivots[i];
+							goto found_persistence_pair;
+						}
+						coface_entries.clear();
+						filtration_entry_t unreduced_pivot(-1);
+#endif
 
-					while (coboundary.has_next()) {
-						filtration_entry_t coface = coboundary.next();
+						auto coboundary = complex.coboundary(cell);
 
-						if (get_filtration(coface) <= max_filtration) {
+						while (coboundary.has_next()) {
+							filtration_entry_t coface = coboundary.next();
+
+							if (get_filtration(coface) <= max_filtration) {
 #ifndef SKIP_APPARENT_PAIRS
-							coface_entries.push_back(coface);
-							if (might_be_apparent_pair && (get_filtration(cell) == get_filtration(coface))) {
-#ifdef USE_ARRAY_HASHMAP
-								if (pivot_column_index[get_index(coface)] == INVALID_INDEX)
+								coface_entries.push_back(coface);
+								if (might_be_apparent_pair &&
+								    (get_index(unreduced_pivot) == -1 || pivot_comparator(unreduced_pivot, coface)))
+									unreduced_pivot = coface;
 #else
-								if (pivot_column_index.find(get_index(coface)) == pivot_column_index.end())
+								iterations++;
+								working_coboundary.push(coface);
 #endif
-								{
-									pivot = coface;
-									goto found_persistence_pair;
-								}
-								might_be_apparent_pair = false;
 							}
-#else
-							iterations++;
-							working_coboundary.push(coface);
-#endif
 						}
-					}
 
 #ifndef SKIP_APPARENT_PAIRS
-					for (auto e : coface_entries) {
-						iterations++;
-						working_coboundary.push(e);
-					}
-#endif
-				}
+						// If no earlier column has the same pivot, then the column is already reduced (emergent pair)
+						if (might_be_apparent_pair) {
+							might_be_apparent_pair = false;
+							if (get_index(unreduced_pivot) != -1 && !pivot_column_index.contains(get_index(unreduced_pivot))) {
+								pivot = unreduced_pivot;
+								goto found_persistence_pair;
+							}
+						}
 
-				if (iterations > max_entries) {
-					// Abort, this is too expensive
-					if (generate_output) output->skipped_column(filtration);
-#ifdef RETRIEVE_PERSISTENCE
-					birth_death.push_back(
-					    std::make_pair(filtration, std::numeric_limits<value_t>::signaling_NaN()));
+						for (auto e : coface_entries) {
+							iterations++;
+							working_coboundary.push(e);
+						}
 #endif
-					betti_error++;
-					break;
-				}
+					}
 
-				pivot = working_coboundary.get_pivot();
+					// Abort, this is too expensive. When retrying, the original budget applies again after the deadline.
+					if (iterations > max_entries &&
+					    (iterations > budget || (retry_skipped_columns && std::chrono::steady_clock::now() > deadline))) {
+						result.kind = column_result_t::SKIPPED;
+						break;
+					}
 
-				if (get_index(pivot) != -1) {
-#ifdef USE_ARRAY_HASHMAP
-					auto pivot_column_idx = pivot_column_index[get_index(pivot)];
+					pivot = working_coboundary.get_pivot();
 
-					if (pivot_column_idx != INVALID_INDEX) {
-						j = pivot_column_idx;
-						continue;
-					}
-#else
-					auto pair = pivot_column_index.find(get_index(pivot));
+					if (get_index(pivot) != -1) {
+						auto pivot_column_idx = pivot_column_index.find(get_index(pivot));
 
-					if (pair != pivot_column_index.end()) {
-						j = pair->second;
-						continue;
-					}
-#endif
-				} else {
-					if (generate_output) {
-						output->new_infinite_barcode(filtration);
-						betti++;
-#ifdef RETRIEVE_PERSISTENCE
-						birth_death.push_back(std::make_pair(filtration, std::numeric_limits<value_t>::infinity()));
-#endif
+						if (pivot_column_idx != INVALID_INDEX) {
+							j = pivot_column_idx;
+							continue;
+						}
+					} else {
+						result.kind = column_result_t::ESSENTIAL;
+						break;
 					}
-					break;
-				}
 
-			found_persistence_pair:
-				value_t death = get_filtration(pivot);
-				if (generate_output && filtration != death) {
-					output->new_barcode(filtration, death);
-#ifdef RETRIEVE_PERSISTENCE
-					birth_death.push_back(std::make_pair(filtration, death));
-#endif
-				}
+				found_persistence_pair:
+					result.kind = column_result_t::PAIRED;
+					result.death = get_filtration(pivot);
+					result.pivot = get_index(pivot);
+					pivot_column_index.insert(get_index(pivot), i);
 
-#ifdef USE_ARRAY_HASHMAP
-				pivot_column_index[get_index(pivot)] = i;
-#else
-				pivot_column_index.insert(std::make_pair(get_index(pivot), i));
+#ifdef USE_COEFFICIENTS
+					const coefficient_t inverse = multiplicative_inverse[get_coefficient(pivot)];
 #endif
 
+#ifdef ASSEMBLE_REDUCTION_MATRIX
+					// replace current column of reduction_coefficients (the implicit diagonal 1 entry)
+					// by reduction_column (possibly with a different entry on the diagonal)
+					size_t number_of_reduction_entries = 0;
+					filtration_entry_t last_reduction_entry;
+					while (true) {
+						filtration_entry_t e = pop_pivot(reduction_column, modulus);
+						if (get_index(e) == -1) break;
 #ifdef USE_COEFFICIENTS
-				const coefficient_t inverse = multiplicative_inverse[get_coefficient(pivot)];
+						set_coefficient(e, inverse * get_coefficient(e) % modulus);
+						assert(get_coefficient(e) > 0);
 #endif
+						reduction_coefficients.push_back(e);
+						last_reduction_entry = e;
+						number_of_reduction_entries++;
+					}
 
-#ifdef ASSEMBLE_REDUCTION_MATRIX
-				// replace current column of reduction_coefficients (with a single diagonal 1 entry)
-				// by reduction_column (possibly with a different entry on the diagonal)
-				reduction_coefficients.pop_back();
-				while (true) {
-					filtration_entry_t e = pop_pivot(reduction_column, modulus);
-					if (get_index(e) == -1) break;
+					// Don't store trivial columns, they are reconstructed from columns_to_reduce
+					if (number_of_reduction_entries == 1 && get_index(last_reduction_entry) == get_index(column_to_reduce) &&
+					    get_coefficient(last_reduction_entry) == 1)
+						reduction_coefficients.pop_back();
+#else
 #ifdef USE_COEFFICIENTS
-					set_coefficient(e, inverse * get_coefficient(e) % modulus);
-					assert(get_coefficient(e) > 0);
+					reduction_coefficients.pop_back();
+					reduction_coefficients.push_back(filtration_entry_t(column_to_reduce, inverse));
 #endif
-					reduction_coefficients.push_back(e);
+#endif
+					break;
+				} while (true);
+
+				result.entries = iterations;
+				result.seconds = 0;
+				if (record_statistics)
+					result.seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - column_start).count();
+				if (result.kind == column_result_t::SKIPPED && first_skipped_column == columns_to_reduce.size())
+					first_skipped_column = i;
+
+				// When retrying, the results are only reported once the final reduction is known
+				if (retry_skipped_columns) {
+					results.push_back(result);
+				} else {
+					report_column(filtration, result);
 				}
+			}
+
+			if (!retry_skipped_columns || first_skipped_column == columns_to_reduce.size() ||
+			    budget == std::numeric_limits<size_t>::max() || std::chrono::steady_clock::now() > deadline)
+				break;
+
+			// Undo the reduction from the first skipped column on, the earlier columns are not affected by it
+			first_column = first_skipped_column;
+			results.resize(first_column);
+			pivot_column_index = pivot_column_index_t(complex.number_of_cells(dimension + 1), columns_to_reduce.size(),
+			                                          pivot_column_index.size());
+			for (index_t i = 0; i < first_column; i++)
+				if (results[i].kind == column_result_t::PAIRED) pivot_column_index.insert(results[i].pivot, i);
+#ifdef ASSEMBLE_REDUCTION_MATRIX
+			reduction_coefficients.truncate(first_column);
 #else
 #ifdef USE_COEFFICIENTS
-				reduction_coefficients.pop_back();
-				reduction_coefficients.push_back(filtration_entry_t(column_to_reduce, inverse));
+			reduction_coefficients.resize(first_column);
 #endif
 #endif
-				break;
-			} while (true);
+
+			budget = budget > std::numeric_limits<size_t>::max() / 4 ? std::numeric_limits<size_t>::max() : 4 * budget;
+			statistics.retries++;
 		}
 
+		if (retry_skipped_columns) {
+			for (index_t i = 0; i < columns_to_reduce.size(); i++)
+				report_column(get_filtration(columns_to_reduce[i]), results[i]);
+		}
+		statistics.final_budget = budget;
+
 #ifdef INDICATE_PROGRESS
 		std::cout << "\033[K";
 #endif
@@ -938,4 +1891,153 @@ protected:
 #endif
 		return std::make_pair(betti, betti_error);
 	}
+
+	std::string checkpoint_filename() const { return checkpoint_directory + "/checkpoint"; }
+	std::string event_log_filename() const { return checkpoint_directory + "/events"; }
+
+	void start_event_log() {
+		if (!recorder->start(event_log_filename())) {
+			std::cerr << "couldn't open the file " << event_log_filename() << std::endl;
+			exit(-1);
+		}
+	}
+
+	// Writes the checkpoint into a temporary file first, so that there always is a complete checkpoint
+	template <typename Reduction>
+	void write_checkpoint(index_t dimension, index_t next_column, const pivot_column_index_t& pivot_column_index,
+	                      Reduction reduction, index_t betti, index_t betti_error) {
+#ifdef INDICATE_PROGRESS
+		std::cout << "\033[K"
+		          << "writing a checkpoint at column " << next_column << "/" << columns_to_reduce.size()
+		          << std::flush << "\r";
+#endif
+		checkpoint_header_t header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+		header.version = CHECKPOINT_VERSION;
+		header.entry_size = sizeof(filtration_entry_t);
+		header.modulus = modulus;
+		header.min_dimension = current_min_dimension;
+		header.max_dimension = current_max_dimension;
+		header.dimension = dimension;
+		header.key = checkpoint_key;
+		header.max_entries = max_entries;
+		header.number_of_cells = complex.number_of_cells(dimension);
+		header.number_of_next_cells = complex.number_of_cells(dimension + 1);
+		header.next_column = next_column;
+		const int64_t number_of_events = recorder->sync();
+		header.number_of_events = number_of_events;
+		header.betti = betti;
+		header.betti_error = betti_error;
+		header.euler_characteristic = euler_characteristic;
+		header.pivot_density = pivot_density;
+
+		std::vector<std::pair<index_t, index_t>> pivots;
+		pivots.reserve(pivot_column_index.size());
+		pivot_column_index.for_each([&pivots](index_t pivot, index_t column) { pivots.emplace_back(pivot, column); });
+		std::vector<filtration_index_t> columns(columns_to_reduce.begin(), columns_to_reduce.end());
+
+		const std::string filename = checkpoint_filename();
+		const std::string temporary_filename = filename + ".tmp";
+		std::FILE* file = std::fopen(temporary_filename.c_str(), "wb");
+		bool success = number_of_events >= 0 && file != nullptr && std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+		               write_vector(file, columns.data(), columns.size()) &&
+		               write_vector(file, pivots.data(), pivots.size()) && write_reduction_columns(file, reduction) &&
+		               std::fflush(file) == 0 && fsync(fileno(file)) == 0;
+		if (file != nullptr) success = std::fclose(file) == 0 && success;
+		success = success && std::rename(temporary_filename.c_str(), filename.c_str()) == 0;
+
+		// A failed checkpoint is not a reason to stop the computation
+		if (!success) std::cerr << "\033[K" << "Could not write the checkpoint " << filename << "." << std::endl;
+		next_checkpoint = std::chrono::steady_clock::now() + checkpoint_interval;
+	}
+
+	// Reads the checkpoint up to the pivots, replays the results reported so far and restores the columns to reduce
+	void read_checkpoint(unsigned int min_dimension, unsigned int max_dimension) {
+		const std::string filename = checkpoint_filename();
+		resume_file = std::fopen(filename.c_str(), "rb");
+		if (resume_file == nullptr) {
+			std::cout << "No checkpoint found in " << checkpoint_directory << ", starting from the beginning." << std::endl;
+			start_event_log();
+			return;
+		}
+
+		std::vector<output_event_t> events;
+		std::vector<filtration_index_t> columns;
+		if (std::fread(&resumed, sizeof(resumed), 1, resume_file) != 1 ||
+		    memcmp(resumed.magic, CHECKPOINT_MAGIC, sizeof(resumed.magic)) != 0 ||
+		    resumed.version != CHECKPOINT_VERSION || resumed.entry_size != sizeof(filtration_entry_t)) {
+			std::cerr << "The checkpoint " << filename << " is not valid." << std::endl;
+			exit(-1);
+		}
+		if (resumed.modulus != modulus || resumed.min_dimension != min_dimension ||
+		    resumed.max_dimension != max_dimension || resumed.max_entries != max_entries) {
+			std::cerr << "The checkpoint " << filename
+			          << " was written with different options (--modulus, --min-dim, --max-dim or --approximate)."
+			          << std::endl;
+			exit(-1);
+		}
+		resumed.key.filtration[sizeof(resumed.key.filtration) - 1] = '\0';
+		if (strcmp(resumed.key.filtration, checkpoint_key.filtration) != 0) {
+			std::cerr << "The checkpoint " << filename << " was written with the filtration \""
+			          << resumed.key.filtration << "\", but this run uses \"" << checkpoint_key.filtration << "\"."
+			          << std::endl;
+			exit(-1);
+		}
+		if (resumed.key.vertices != checkpoint_key.vertices || resumed.key.edges != checkpoint_key.edges ||
+		    resumed.key.graph_hash != checkpoint_key.graph_hash) {
+			std::cerr << "The checkpoint " << filename << " was written for a different graph." << std::endl;
+			exit(-1);
+		}
+		if (!read_vector(resume_file, columns) ||
+		    !recorder->resume(event_log_filename(), resumed.number_of_events, events)) {
+			std::cerr << "The checkpoint " << filename << " is not valid." << std::endl;
+			exit(-1);
+		}
+
+		std::cout << "Resuming from the checkpoint in dimension " << resumed.dimension << " at column "
+		          << resumed.next_column << "/" << columns.size() << "." << std::endl;
+		recorder->replay(events);
+		if (print_betti_numbers_to_console) {
+			std::cout << "The dimensions of the mod-" << modulus << " homology of the full complex are:" << std::endl
+			          << std::endl;
+			uint64_t dimension = 0;
+			for (const auto& e : events) {
+				if (e.kind == output_event_t::DIMENSION) dimension = e.number;
+				if (e.kind != output_event_t::BETTI_NUMBER) continue;
+				std::cout << "dim H_" << dimension << " = " << e.number;
+				if (e.skipped > 0) std::cout << " (skipped " << e.skipped << ")";
+				std::cout << std::endl;
+			}
+		}
+
+		columns_to_reduce.assign(columns.begin(), columns.end());
+		euler_characteristic = resumed.euler_characteristic;
+		pivot_density = resumed.pivot_density;
+	}
+
+	// Restores the pivots and the reduction matrix of the checkpoint, returns the column to continue with
+	template <typename Reduction>
+	index_t resume_reduction(index_t dimension, pivot_column_index_t& pivot_column_index, Reduction reduction,
+	                         index_t& betti, index_t& betti_error) {
+		if (complex.number_of_cells(dimension) != resumed.number_of_cells ||
+		    complex.number_of_cells(dimension + 1) != resumed.number_of_next_cells) {
+			std::cerr << "The checkpoint " << checkpoint_filename() << " belongs to a different complex." << std::endl;
+			exit(-1);
+		}
+
+		std::vector<std::pair<index_t, index_t>> pivots;
+		if (!read_vector(resume_file, pivots) || !read_reduction_columns(resume_file, reduction)) {
+			std::cerr << "The checkpoint " << checkpoint_filename() << " is not valid." << std::endl;
+			exit(-1);
+		}
+		for (const auto& p : pivots) pivot_column_index.insert(p.first, p.second);
+
+		std::fclose(resume_file);
+		resume_file = nullptr;
+		next_checkpoint = std::chrono::steady_clock::now() + checkpoint_interval;
+		betti = resumed.betti;
+		betti_error = resumed.betti_error;
+		return resumed.next_column;
+	}
 };
@@ -3,7 +3,9 @@
 #include <iostream>
 
 #include "../output/output_classes.h"
+#include "output.h"
 
 void print_cell_output_usage() {
 	std::cerr << "  --out filename     write lists of all cells into an HDF5 file" << std::endl;
+	print_hdf5_output_usage();
 }
\ No newline at end of file
@@ -20,6 +20,18 @@ void print_usage_and_exit(int exit_code) {
 	print_output_usage();
 	print_input_usage();
 	print_homology_usage();
+	std::cerr << "  --batch manifest   compute all graphs listed in the file manifest (one per line) or in the" << std::endl
+	          << "                     directory manifest, the results are written into a single file" << std::endl
+	          << "  --batch-small-graph-size n  together with --batch: compute the graph files of at most" << std::endl
+	          << "                     n MB (defaults to 4) at the same time" << std::endl
+	          << "  --apparent-pairs   look for apparent pairs before the reduction of every dimension, this" << std::endl
+	          << "                     takes two passes over the coboundaries and pays off if many columns" << std::endl
+	          << "                     form apparent pairs" << std::endl
+	          << "  --checkpoint folder  save the state of the reduction in the given folder regularly" << std::endl
+	          << "  --checkpoint-interval t  together with --checkpoint: save the state every t seconds" << std::endl
+	          << "                     (defaults to 1800)" << std::endl
+	          << "  --resume           together with --checkpoint: continue from the checkpoint in the folder," << std::endl
+	          << "                     all results are written to the (new) output file again" << std::endl;
 	print_help_usage();
 
 	std::cerr << std::endl
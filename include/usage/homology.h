@@ -22,5 +22,13 @@ void print_homology_usage(bool no_filtration = false) {
 	          << "  --approximate n    skip all columns creating columns in the reduction matrix with" << std::endl
 	          << "                     n non-trivial entries. Use this for hard problems, a good value" << std::endl
 	          << "                     is often 100000. Increase for higher precision, decrease for faster computation."
-	          << std::endl;
+	          << std::endl
+	          << "  --time-budget t    together with --approximate: retry the skipped columns with a larger" << std::endl
+	          << "                     budget until t seconds have passed" << std::endl
+#ifdef ASSEMBLE_REDUCTION_MATRIX
+	          << "  --reduction-memory n  keep at most n MB of the reduction matrix in memory, the rest is moved"
+	          << std::endl
+	          << "                     to a temporary file" << std::endl
+#endif
+	    ;
 }
\ No newline at end of file
@@ -16,15 +16,19 @@ void print_input_usage() {
 	          << "                     \"grouped\" if the connectivity matrices are grouped. To only" << std::endl
 	          << "                     consider a subset of the groups you can list them after" << std::endl
 	          << "                     \"grouped\", e.g. \"grouped:L1_DAC,L2*\". The star is a placeholder" << std::endl
-	          << "                     for arbitrary characters. The type defaults to \"matrix\" and is" << std::endl
+	          << "                     for arbitrary characters. Sparse matrices can be given as \"csr\"" << std::endl
+	          << "                     (datasets indptr, indices and optionally data) or as \"coo\"" << std::endl
+	          << "                     (datasets row, col and optionally data) in the group at the given" << std::endl
+	          << "                     path. The type defaults to \"matrix\" and is" << std::endl
 	          << "                     only relevant for the input type h5." << std::endl
 #ifndef WITH_HDF5
 	          << " [HDF5 library not found]" << std::endl
 #endif
+	          << "  -                  instead of a filename: read a graph in the format flagser or binary" << std::endl
+	          << "                     from the standard input" << std::endl
 	          << "  --undirected       compute the *undirected* flag complex" << std::endl
 	          << "  --components       compute the directed flag complex for each individual connected" << std::endl
-	          << "                     component of the input graph. Warning: this currently only works" << std::endl
-	          << "                     for the trivial filtration. Additionally, isolated vertices are" << std::endl
-	          << "                     ignored." << std::endl
+	          << "                     component of the input graph, the components are numbered in the" << std::endl
+	          << "                     order of their smallest vertex. Isolated vertices are ignored." << std::endl
 	          << std::endl;
 }
\ No newline at end of file
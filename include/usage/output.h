@@ -4,10 +4,20 @@
 
 #include "../output/output_classes.h"
 
+void print_hdf5_output_usage() {
+#ifdef WITH_HDF5
+	std::cerr << "  --h5-chunk-size n  store the HDF5 output in chunks of n rows (defaults to 10000)" << std::endl
+	          << "  --h5-compression level  compress the HDF5 output with the given deflate level (1 to 9)"
+	          << std::endl
+	          << "  --h5-shuffle       apply the shuffle filter before the compression" << std::endl;
+#endif
+}
+
 void print_output_usage() {
 	std::cerr << "  --out filename     write the barcodes to the given file" << std::endl
 	          << "  --out-format       the format of the output file. Defaults to \"barcode\". Available options are:"
 	          << std::endl;
 
 	for (auto f : available_output_formats) std::cerr << "                         " << f << std::endl;
+	print_hdf5_output_usage();
 }
\ No newline at end of file
@@ -0,0 +1,69 @@
+/**
+ * Converts a graph from one of the input formats of flagser into another one.
+ */
+
+#include <fstream>
+#include <iostream>
+
+#include "../include/argparser.h"
+#include "../include/input/input_classes.h"
+
+void print_usage_and_exit(int exit_code) {
+	std::cerr << "Usage: "
+	          << "convert-graph "
+	          << "[options] input_filename output_filename" << std::endl
+	          << std::endl
+	          << "Options:" << std::endl
+	          << std::endl
+	          << "  --in-format format     the format of the input file (flagser, h5 or binary), defaults to flagser"
+	          << std::endl
+	          << "  --h5-type type         the type of data in the h5-file, see the documentation of flagser"
+	          << std::endl
+	          << "  --out-format format    the format of the output file (flagser or binary), defaults to binary"
+	          << std::endl
+	          << "  --undirected           store every edge only once, from the smaller to the larger vertex" << std::endl
+	          << "  --help                 print this screen" << std::endl
+	          << std::endl;
+
+	exit(exit_code);
+}
+
+int main(int argc, char** argv) {
+	auto arguments = parse_arguments(argc, argv);
+
+	auto positional_arguments = get_positional_arguments(arguments);
+	auto named_arguments = get_named_arguments(arguments);
+	if (named_arguments.find("help") != named_arguments.end()) { print_usage_and_exit(0); }
+	if (positional_arguments.size() != 2) { print_usage_and_exit(-1); }
+
+	const std::string out_format = get_argument_or_default(named_arguments, "out-format", "binary");
+	if (out_format != "binary" && out_format != "flagser") {
+		std::cerr << "The output format \"" << out_format << "\" could not be found." << std::endl;
+		exit(-1);
+	}
+
+	std::ifstream f(positional_arguments[1]);
+	if (f.good()) {
+		std::cerr << "The output file already exists, aborting." << std::endl;
+		exit(-1);
+	}
+
+	filtered_directed_graph_t graph = read_filtered_directed_graph(positional_arguments[0], named_arguments);
+
+	std::ofstream output_stream(positional_arguments[1], std::ios::binary);
+	if (output_stream.fail()) {
+		std::cerr << "couldn't open file " << positional_arguments[1] << std::endl;
+		exit(-1);
+	}
+
+	if (out_format == "binary")
+		write_graph_binary(graph, output_stream);
+	else
+		write_graph_flagser(graph, output_stream);
+
+	output_stream.close();
+	if (output_stream.fail()) {
+		std::cerr << "couldn't write file " << positional_arguments[1] << std::endl;
+		exit(-1);
+	}
+}
@@ -1,5 +1,6 @@
 #include <fstream>
 #include <iostream>
+#include <memory>
 
 #define ASSEMBLE_REDUCTION_MATRIX
 #define INDICATE_PROGRESS
@@ -59,12 +60,17 @@ void count_cells(filtered_directed_graph_t& graph, const named_arguments_t& name
 		struct cell_counter_t {
 #ifdef WITH_HDF5
 		private:
-			hdf5_output_t* output;
+			std::unique_ptr<hdf5_cell_buffer_t> cells;
 
 		public:
-			cell_counter_t(hdf5_output_t* _output = nullptr) : output(_output) {}
+			cell_counter_t(hdf5_output_t* output = nullptr)
+			    : cells(output != nullptr ? new hdf5_cell_buffer_t(output) : nullptr) {}
 #endif
-			void done() {}
+			void done() {
+#ifdef WITH_HDF5
+				if (cells != nullptr) cells->flush();
+#endif
+			}
 			void operator()(vertex_index_t* first_vertex, int size) {
 				// Add (-1)^size to the Euler characteristic
 				if (size & 1)
@@ -76,7 +82,7 @@ void count_cells(filtered_directed_graph_t& graph, const named_arguments_t& name
 				cell_counts[size - 1]++;
 
 #ifdef WITH_HDF5
-				if (output != nullptr) output->write_cell(first_vertex, size);
+				if (cells != nullptr) cells->write_cell(first_vertex, size);
 #endif
 			}
 
@@ -96,15 +102,7 @@ void count_cells(filtered_directed_graph_t& graph, const named_arguments_t& name
 #endif
 			);
 
-#ifdef WITH_HDF5
-		if (output != nullptr)
-			complex.for_each_cell(*cell_counter[0], 0, 10000);
-		else {
-#endif
-			complex.for_each_cell(cell_counter, 0, 10000);
-#ifdef WITH_HDF5
-		}
-#endif
+		complex.for_each_cell(cell_counter, 0, 10000);
 		int64_t euler_characteristic = 0;
 		for (int i = 0; i < PARALLEL_THREADS; i++) euler_characteristic += cell_counter[i]->euler_characteristic();
 
@@ -131,6 +129,7 @@ void count_cells(filtered_directed_graph_t& graph, const named_arguments_t& name
 			total_cell_count[dim] += size;
 		}
 		std::cout << std::endl;
+		for (int i = 0; i < PARALLEL_THREADS; i++) delete cell_counter[i];
 		total_euler_characteristic += euler_characteristic;
 		total_max_dim = std::max(total_max_dim, max_dim);
 
@@ -1,9 +1,15 @@
+#include <atomic>
+#include <chrono>
+#include <dirent.h>
 #include <fstream>
 #include <iostream>
+#include <new>
+#include <sstream>
+#include <sys/stat.h>
+#include <thread>
 
 #define ASSEMBLE_REDUCTION_MATRIX
 #define INDICATE_PROGRESS
-#define SKIP_APPARENT_PAIRS
 #define USE_ARRAY_HASHMAP
 #define USE_CELLS_WITHOUT_DIMENSION
 #define SORT_COLUMNS_BY_PIVOT
@@ -35,13 +41,35 @@ typedef directed_flag_complex_computer_t
     directed_flag_complex_compute_t;
 #endif
 
+// Discards everything, used to silence the progress output of graphs computed at the same time
+class null_buffer_t : public std::streambuf {
+protected:
+	int overflow(int c) override { return c; }
+	std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+// Redirects the standard output to a null buffer while it exists, unless it is already silenced
+class silence_standard_output_t {
+	static null_buffer_t null_buffer;
+	std::streambuf* standard_output;
+
+public:
+	silence_standard_output_t() : standard_output(std::cout.rdbuf()) {
+		if (standard_output != &null_buffer) std::cout.rdbuf(&null_buffer);
+	}
+	~silence_standard_output_t() {
+		if (standard_output != &null_buffer) std::cout.rdbuf(standard_output);
+	}
+};
+null_buffer_t silence_standard_output_t::null_buffer;
+
 #ifdef RETRIEVE_PERSISTENCE
 std::vector<persistence_computer_t<directed_flag_complex_compute_t>>
 #else
 void
 #endif
 compute_homology(filtered_directed_graph_t& graph, const named_arguments_t& named_arguments, size_t max_entries,
-                 coefficient_t modulus) {
+                 coefficient_t modulus, std::ostream* output_stream = nullptr, bool concurrent_components = true) {
 
 	unsigned int max_dimension = std::numeric_limits<unsigned int>::max();
 	unsigned int min_dimension = 0;
@@ -50,6 +78,31 @@ compute_homology(filtered_directed_graph_t& graph, const named_arguments_t& name
 	named_arguments_t::const_iterator it;
 	if ((it = named_arguments.find("max-dim")) != named_arguments.end()) { max_dimension = atoi(it->second); }
 	if ((it = named_arguments.find("min-dim")) != named_arguments.end()) { min_dimension = atoi(it->second); }
+	size_t reduction_memory = std::numeric_limits<size_t>::max();
+	if ((it = named_arguments.find("reduction-memory")) != named_arguments.end()) {
+		reduction_memory = atol(it->second) * 1000000;
+	}
+	const bool has_time_budget = argument_was_passed(named_arguments, "time-budget");
+	const bool use_apparent_pairs = argument_was_passed(named_arguments, "apparent-pairs");
+	if (has_time_budget && max_entries == std::numeric_limits<size_t>::max()) {
+		std::cerr << "The option --time-budget can only be used together with --approximate." << std::endl;
+		exit(-1);
+	}
+	const auto deadline = std::chrono::steady_clock::now() +
+	                      std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(
+	                          atof(get_argument_or_default(named_arguments, "time-budget", "0"))));
+
+	const bool has_checkpoints = argument_was_passed(named_arguments, "checkpoint");
+	const bool resume = argument_was_passed(named_arguments, "resume");
+	if (resume && !has_checkpoints) {
+		std::cerr << "The option --resume needs the directory of the checkpoints via --checkpoint." << std::endl;
+		exit(-1);
+	}
+	if (has_checkpoints && (split_into_connected_components || has_time_budget)) {
+		std::cerr << "The option --checkpoint can not be used together with --components or --time-budget." << std::endl;
+		exit(-1);
+	}
+	const double checkpoint_interval = atof(get_argument_or_default(named_arguments, "checkpoint-interval", "1800"));
 
 	std::vector<filtered_directed_graph_t> subgraphs{graph};
 	if (split_into_connected_components) { subgraphs = graph.get_connected_subgraphs(2); }
@@ -58,9 +111,97 @@ compute_homology(filtered_directed_graph_t& graph, const named_arguments_t& name
 	std::vector<persistence_computer_t<directed_flag_complex_compute_t>> complex_subgraphs;
 #endif
 
-	auto output = get_output<directed_flag_complex_compute_t>(named_arguments);
+	auto output = get_output<directed_flag_complex_compute_t>(named_arguments, output_stream);
+
+#ifndef RETRIEVE_PERSISTENCE
+	if (split_into_connected_components && concurrent_components && subgraphs.size() > 1 &&
+	    output_can_be_combined(named_arguments)) {
+		// Every component writes into its own output, which are combined in the original order at the end
+		std::vector<std::ostringstream> results(subgraphs.size());
+		std::vector<output_t<directed_flag_complex_compute_t>*> outputs(subgraphs.size());
+		const auto compute_component = [&](size_t i, std::ostream& console) {
+			outputs[i] = get_output<directed_flag_complex_compute_t>(named_arguments, &results[i]);
+			directed_flag_complex_compute_t complex(subgraphs[i], named_arguments);
+			outputs[i]->set_complex(&complex);
+			if (i > 0) outputs[i]->print("\n");
+			outputs[i]->print("## Path component number " + std::to_string(i + 1) + "\n");
+
+			persistence_computer_t<decltype(complex)> persistence_computer(complex, outputs[i], max_entries, modulus);
+			persistence_computer.set_reduction_matrix_memory(reduction_memory);
+			persistence_computer.set_apparent_pairs(use_apparent_pairs);
+			persistence_computer.set_console(console);
+			if (has_time_budget) persistence_computer.set_deadline(deadline);
+			persistence_computer.compute_persistence(min_dimension, max_dimension);
+		};
+		const auto size = [&subgraphs](size_t i) { return subgraphs[i].vertex_number() + subgraphs[i].edge_number(); };
+
+		// Largest first, so that the last components to be computed are the small ones
+		std::vector<size_t> order(subgraphs.size());
+		for (size_t i = 0; i < order.size(); i++) order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&size](size_t a, size_t b) { return size(a) > size(b); });
+
+		size_t next = 0;
+		for (; next < order.size() && size(order[next]) >= LARGE_COMPONENT_SIZE; next++) {
+#ifdef INDICATE_PROGRESS
+			std::cout << "\033[K";
+#endif
+			std::cout << "# Path component number " << (order[next] + 1) << std::endl;
+			compute_component(order[next], std::cout);
+		}
+
+		// The small components are distributed over a pool of threads, their Betti numbers are collected and
+		// printed in the order of the components at the end
+		if (next < order.size()) {
+#ifdef INDICATE_PROGRESS
+			std::cout << "\033[K"
+			          << "computing " << (order.size() - next) << " small components" << std::flush << "\r";
+#endif
+			std::vector<std::ostringstream> summaries(subgraphs.size());
+			{
+				silence_standard_output_t silence;
+				std::atomic<size_t> next_component(next);
+				std::vector<std::thread> threads;
+				for (int t = 0; t < PARALLEL_THREADS; t++) {
+					threads.push_back(std::thread([&]() {
+						compute_serially() = true;
+						for (size_t i; (i = next_component++) < order.size();)
+							compute_component(order[i], summaries[order[i]]);
+					}));
+				}
+				for (auto& thread : threads) thread.join();
+			}
+
+#ifdef INDICATE_PROGRESS
+			std::cout << "\033[K";
+#endif
+			std::vector<size_t> small_components(order.begin() + next, order.end());
+			std::sort(small_components.begin(), small_components.end());
+			for (auto i : small_components)
+				std::cout << "# Path component number " << (i + 1) << std::endl << summaries[i].str();
+		}
+
+		for (size_t i = 0; i < subgraphs.size(); i++) {
+			output->print(results[i].str());
+			output->add_results_of(outputs[i]);
+			delete outputs[i];
+		}
+
+		output->print("\n## Total\n");
+		output->print_aggregated_results();
+		delete output;
+		return;
+	}
+#endif
+
 	size_t component_number = 1;
 	for (auto subgraph : subgraphs) {
+#ifndef RETRIEVE_PERSISTENCE
+		// The complex changes the filtration values of the graph
+		coboundary_cache_key_t checkpoint_key;
+		if (has_checkpoints)
+			checkpoint_key = coboundary_cache_key(get_argument_or_default(named_arguments, "filtration", "zero"),
+			                                      modulus, subgraph);
+#endif
 		directed_flag_complex_compute_t complex(subgraph, named_arguments);
 
 		output->set_complex(&complex);
@@ -81,9 +222,18 @@ compute_homology(filtered_directed_graph_t& graph, const named_arguments_t& name
 
 #ifdef RETRIEVE_PERSISTENCE
 		complex_subgraphs.push_back(persistence_computer_t<decltype(complex)>(complex, output, max_entries, modulus));
+		complex_subgraphs.back().set_reduction_matrix_memory(reduction_memory);
+		complex_subgraphs.back().set_apparent_pairs(use_apparent_pairs);
+		if (has_time_budget) complex_subgraphs.back().set_deadline(deadline);
 		complex_subgraphs.back().compute_persistence(min_dimension, max_dimension);
 #else
 		persistence_computer_t<decltype(complex)> persistence_computer(complex, output, max_entries, modulus);
+		persistence_computer.set_reduction_matrix_memory(reduction_memory);
+		persistence_computer.set_apparent_pairs(use_apparent_pairs);
+		if (has_time_budget) persistence_computer.set_deadline(deadline);
+		if (has_checkpoints)
+			persistence_computer.set_checkpoints(named_arguments.at("checkpoint"), checkpoint_interval, resume,
+			                                     checkpoint_key);
 		persistence_computer.compute_persistence(min_dimension, max_dimension);
 #endif
 	}
@@ -94,9 +244,153 @@ compute_homology(filtered_directed_graph_t& graph, const named_arguments_t& name
 
 #ifdef RETRIEVE_PERSISTENCE
 	return complex_subgraphs;
+#else
+	delete output;
 #endif
 }
 
+std::vector<std::string> read_batch_manifest(const std::string& manifest) {
+	std::vector<std::string> filenames;
+
+	DIR* directory = opendir(manifest.c_str());
+	if (directory != nullptr) {
+		while (dirent* entry = readdir(directory)) {
+			const std::string filename = manifest + "/" + entry->d_name;
+			struct stat status;
+			if (stat(filename.c_str(), &status) == 0 && S_ISREG(status.st_mode)) filenames.push_back(filename);
+		}
+		closedir(directory);
+		std::sort(filenames.begin(), filenames.end());
+		return filenames;
+	}
+
+	// Otherwise the manifest lists one graph per line, empty lines and lines starting with # are ignored
+	std::ifstream manifest_stream;
+	open_file(manifest, manifest_stream);
+	std::string line;
+	while (std::getline(manifest_stream, line)) {
+		line = trim(line);
+		if (line.size() > 0 && line[0] != '#') filenames.push_back(line);
+	}
+	return filenames;
+}
+
+// Computes the homology of one graph of a batch into the result. Returns the error message if the graph could not
+// be read or there was not enough memory, the other graphs are computed anyway.
+std::string compute_graph_of_batch(const std::string& filename, const named_arguments_t& named_arguments,
+                                   size_t max_entries, coefficient_t modulus, std::ostream& result,
+                                   bool concurrent_components) {
+	input_errors_are_thrown() = true;
+	try {
+		filtered_directed_graph_t graph = read_filtered_directed_graph(filename, named_arguments);
+		compute_homology(graph, named_arguments, max_entries, modulus, &result, concurrent_components);
+	} catch (const input_error_t& error) {
+		return error.what();
+	} catch (const std::bad_alloc&) {
+		return "There is not enough memory to compute the homology of the graph " + filename + ".";
+	}
+	return "";
+}
+
+// Computes the homology of every graph in the manifest and writes the results into a single file in the order of
+// the manifest. Runs of consecutive small graphs are distributed over a pool of threads that compute one graph
+// each without starting more threads, large graphs are computed one after the other. If a graph can not be read
+// or computed, this is noted in the output and the remaining graphs are computed anyway. Returns the number of
+// graphs that failed.
+size_t compute_batch(const std::string& manifest, const named_arguments_t& named_arguments, size_t max_entries,
+                     coefficient_t modulus) {
+	if (argument_was_passed(named_arguments, "cache") || argument_was_passed(named_arguments, "checkpoint")) {
+		std::cerr << "The options --cache and --checkpoint can not be used together with --batch." << std::endl;
+		exit(-1);
+	}
+
+	const auto filenames = read_batch_manifest(manifest);
+	const size_t small_graph_bytes =
+	    atol(get_argument_or_default(named_arguments, "batch-small-graph-size", "4")) * 1000000;
+
+	const auto filename =
+	    get_argument_or_fail(named_arguments, "out", "Please provide an output filename via \"--out filename\" .");
+	if (std::ifstream(filename).good()) {
+		std::cerr << "The output file already exists, aborting." << std::endl;
+		exit(-1);
+	}
+	std::ofstream output_stream(filename);
+	if (output_stream.fail()) {
+		std::cerr << "couldn't open file " << filename << std::endl;
+		exit(-1);
+	}
+
+	const auto is_small = [&](const std::string& graph_filename) {
+		struct stat status;
+		return stat(graph_filename.c_str(), &status) == 0 && size_t(status.st_size) <= small_graph_bytes;
+	};
+
+	size_t failed = 0;
+	for (size_t first = 0, last; first < filenames.size(); first = last) {
+		// Find the next run of small graphs, or take the next large graph alone
+		last = first + 1;
+		if (is_small(filenames[first]))
+			while (last < filenames.size() && is_small(filenames[last])) last++;
+
+#ifdef INDICATE_PROGRESS
+		std::cout << "\033[K"
+		          << "computing graph " << (first + 1);
+		if (last > first + 1) std::cout << "-" << last;
+		std::cout << " of " << filenames.size() << std::flush << "\r";
+#endif
+
+		// Every graph writes into its own buffer, the buffers are written in the order of the manifest
+		std::vector<std::ostringstream> results(last - first);
+		std::vector<std::string> errors(last - first);
+		{
+			silence_standard_output_t silence;
+			if (last == first + 1) {
+				errors[0] = compute_graph_of_batch(filenames[first], named_arguments, max_entries, modulus, results[0],
+				                                   true);
+			} else {
+				std::atomic<size_t> next_graph(first);
+				std::vector<std::thread> threads;
+				for (size_t t = 0; t < std::min(size_t(PARALLEL_THREADS), last - first); t++) {
+					threads.push_back(std::thread([&]() {
+						compute_serially() = true;
+						for (size_t i; (i = next_graph++) < last;)
+							errors[i - first] = compute_graph_of_batch(filenames[i], named_arguments, max_entries,
+							                                           modulus, results[i - first], false);
+					}));
+				}
+				for (auto& thread : threads) thread.join();
+			}
+		}
+
+		for (size_t i = first; i < last; i++) {
+			output_stream << (i > 0 ? "\n" : "") << "## Graph " << filenames[i] << "\n";
+			if (errors[i - first].empty()) {
+				output_stream << results[i - first].str();
+				continue;
+			}
+#ifdef INDICATE_PROGRESS
+			std::cout << "\033[K";
+#endif
+			std::cerr << errors[i - first] << std::endl
+			          << "The computation of the graph " << filenames[i] << " failed, continuing with the others."
+			          << std::endl;
+			output_stream << "## Failed\n";
+			failed++;
+		}
+	}
+
+#ifdef INDICATE_PROGRESS
+	std::cout << "\033[K";
+#endif
+
+	output_stream.close();
+	if (output_stream.fail()) {
+		std::cerr << "couldn't write file " << filename << std::endl;
+		exit(-1);
+	}
+	return failed;
+}
+
 int main(int argc, char** argv) {
 	auto arguments = parse_arguments(argc, argv);
 
@@ -104,10 +398,8 @@ int main(int argc, char** argv) {
 	auto named_arguments = get_named_arguments(arguments);
 	if (named_arguments.find("help") != named_arguments.end()) { print_usage_and_exit(-1); }
 
-	if (positional_arguments.size() == 0) { print_usage_and_exit(-1); }
-	const char* input_filename = positional_arguments[0];
-
-	filtered_directed_graph_t graph = read_filtered_directed_graph(input_filename, named_arguments);
+	const bool batch = argument_was_passed(named_arguments, "batch");
+	if (positional_arguments.size() == 0 && !batch) { print_usage_and_exit(-1); }
 
 	size_t max_entries = std::numeric_limits<size_t>::max();
 	coefficient_t modulus = 2;
@@ -117,5 +409,8 @@ int main(int argc, char** argv) {
 	if ((it = named_arguments.find("modulus")) != named_arguments.end()) { modulus = atoi(it->second); }
 #endif
 
+	if (batch) return compute_batch(named_arguments.at("batch"), named_arguments, max_entries, modulus) == 0 ? 0 : -1;
+
+	filtered_directed_graph_t graph = read_filtered_directed_graph(positional_arguments[0], named_arguments);
 	compute_homology(graph, named_arguments, max_entries, modulus);
 }
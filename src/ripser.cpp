@@ -33,6 +33,7 @@ with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cmath>
 #include <fstream>
 #include <iostream>
@@ -554,6 +555,7 @@ int main(int argc, char** argv) {
 
 	size_t max_entries = std::numeric_limits<size_t>::max();
 	if ((it = named_arguments.find("approximate")) != named_arguments.end()) { max_entries = atoi(it->second); }
+	const auto start_time = std::chrono::steady_clock::now();
 
 
 	std::ifstream file_stream(positional_arguments[0]);
@@ -579,6 +581,10 @@ int main(int argc, char** argv) {
   output->set_complex(&vietoris_rips_complex);
 
 	persistence_computer_t<decltype(vietoris_rips_complex)> persistence_computer(vietoris_rips_complex, output, max_entries, modulus, threshold);
+	if ((it = named_arguments.find("time-budget")) != named_arguments.end()) {
+		persistence_computer.set_deadline(start_time + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		                                                   std::chrono::duration<double>(atof(it->second))));
+	}
 	persistence_computer.compute_persistence(dim_min, dim_max, false);
 	output->print_aggregated_results();
 }